@@ -0,0 +1,62 @@
+// -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+//  Protocol for content producers running on the same host as the
+//  PixelPusher server. Instead of sending UDP packets over loopback, they
+//  write frames directly into shared memory.
+//
+//  Copyright (C) 2026 The pixelpusher-server authors
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef PIXEL_PUSH_LOCAL_PRODUCER_H
+#define PIXEL_PUSH_LOCAL_PRODUCER_H
+
+#include <stdint.h>
+
+// The exchange goes like this:
+//
+//  1. Connect to the Unix domain stream socket at
+//     PPOptions::local_socket_path.
+//  2. The server sends a LocalFrameInfo message, with the file descriptor of
+//     the shared memory attached (SCM_RIGHTS). mmap() it read/write with
+//     shm_size bytes. Each connection gets new shared memory; the server
+//     stops looking at it when the connection closes.
+//  3. To show a frame, write the pixels to one of the num_buffers frame
+//     buffers; buffer i starts at i * buffer_size. A frame buffer contains
+//     all strips one after another, each with pixels_per_strip packed RGB
+//     triplets. Then send the buffer index as uint32_t.
+//  4. The server replies with the same uint32_t once it is done with the
+//     buffer. Don't write to that buffer before. With two buffers, you can
+//     fill one while the server shows the other.
+//
+// Only one producer is served at a time. While one is connected, further
+// connections are closed right away: step 2 sees end-of-file. Try again once
+// the other producer is gone.
+//
+// All values are in host byte order.
+namespace pp {
+static const uint32_t kLocalFrameMagic = 0x50504c46;   // "PPLF"
+static const uint32_t kLocalFrameVersion = 1;
+
+struct LocalFrameInfo {
+    uint32_t magic;             // kLocalFrameMagic
+    uint32_t version;           // kLocalFrameVersion
+    uint32_t num_strips;
+    uint32_t pixels_per_strip;
+    uint32_t num_buffers;
+    uint32_t buffer_size;       // bytes: 3 * num_strips * pixels_per_strip
+    uint32_t shm_size;          // bytes: num_buffers * buffer_size
+};
+}  // namespace pp
+
+#endif  /* PIXEL_PUSH_LOCAL_PRODUCER_H */
@@ -22,6 +22,9 @@
 #ifndef PIXEL_PUSH_SERVER_H
 #define PIXEL_PUSH_SERVER_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 namespace pp {
 
 // Pixel color.
@@ -35,6 +38,35 @@ struct PixelColor {
     uint8_t blue;
 };
 
+// Pixel color of RGBW strips, which have an additional white LED.
+struct PixelColorRGBW {
+    uint8_t red;
+    uint8_t green;
+    uint8_t blue;
+    uint8_t white;
+};
+
+// Wire formats of common LED chipsets. If an OutputDevice asks for one of
+// these, the server encodes each strip into a buffer that is ready to be sent
+// out, e.g. via SPI DMA, and passes it to SetEncodedStrip().
+enum WireEncoding {
+    WIRE_NONE,         // No encoding, pixels are passed with SetPixel().
+
+    // WS2812/WS2811 bit timing generated with SPI at 2.4MHz: each data bit
+    // becomes three SPI bits, 110 for a 1 and 100 for a 0. Pixels in GRB
+    // order, followed by 90 zero bytes (300usec) as reset.
+    WIRE_WS2812_SPI,
+
+    // APA102/SK9822: 32 bit start frame of zeros, then for each pixel
+    // 0xFF (full global brightness), blue, green, red. Followed by an end
+    // frame of (pixels + 15) / 16 bytes 0xFF.
+    WIRE_APA102,
+
+    // LPD8806: 7 bit per color in GRB order with the high bit set, followed
+    // by (pixels + 31) / 32 zero bytes as latch.
+    WIRE_LPD8806
+};
+
 // This is an abstract class that you have to implement that fits your
 // particular output device. Implementations by Henner Zeller are available
 // for RGB Matrix and Spixels.
@@ -63,6 +95,44 @@ public:
     virtual void SetPixel(int strip, int pixel,
                           const ::pp::PixelColor &col) = 0;
 
+    // Return the wire encoding this device wants for its strips. If this is
+    // not WIRE_NONE, SetEncodedStrip() is called instead of SetPixel().
+    virtual ::pp::WireEncoding wire_encoding() const { return WIRE_NONE; }
+
+    // Callback from server with the encoded data of a whole strip. The
+    // buffer is only valid until this call returns.
+    virtual void SetEncodedStrip(int strip, const uint8_t *data, size_t len) {}
+
+    // Return true if the given strip has RGBW pixels. For these, the server
+    // extracts the white portion of the received RGB colors (see
+    // PPOptions::rgbw_white_point) and calls SetStripRGBW() instead of
+    // SetPixel() or SetEncodedStrip().
+    virtual bool is_rgbw_strip(int strip) const { return false; }
+
+    // Callback from server with all "count" pixels of an RGBW strip. The
+    // buffer is only valid until this call returns.
+    virtual void SetStripRGBW(int strip, const ::pp::PixelColorRGBW *pixels,
+                              int count) {}
+
+    // Return the rate (in Hz) this device refreshes its display with, if it
+    // wants to be refreshed by the server; 0 (default) if it just wants
+    // frames as they arrive. If this is > 0, StartFrame() .. FlushFrame()
+    // are called at that rate from a separate thread with all strips, each
+    // time with the current state of a smooth transition from the previous
+    // to the latest received frame, temporally dithered down to
+    // output_bit_depth(). This costs one frame interval of latency.
+    virtual int refresh_rate_hz() const { return 0; }
+
+    // Bits per color channel the device can show (8..16). With more than 8
+    // and a refresh_rate_hz(), SetStripHighDepth() is called for RGB strips
+    // instead of SetPixel(). Wire encodings and RGBW strips are 8 bit.
+    virtual int output_bit_depth() const { return 8; }
+
+    // Callback from server with all "count" pixels of a strip as packed
+    // RGB triplets, each value in the range 0..(1 << output_bit_depth()) - 1.
+    // The buffer is only valid until this call returns.
+    virtual void SetStripHighDepth(int strip, const uint16_t *rgb, int count) {}
+
     // Called from the PixelPusher server, after all the Pixels for a received
     // packet have ben SetPixel()ed.
     virtual void FlushFrame() = 0;
@@ -83,6 +153,12 @@ struct PPOptions {
     const char *network_interface;
     int udp_packet_size;
 
+    // If set, ignore udp_packet_size and derive it from the MTU of the
+    // network interface instead: the largest packet that is not fragmented.
+    // With jumbo frames, a whole frame fits in one or two packets.
+    // The MTU is watched and changes are advertised to the senders.
+    bool udp_packet_size_from_mtu;
+
     bool is_logarithmic;    // If out output is logarithmic
 
     // PixelPusher group and controller
@@ -92,11 +168,61 @@ struct PPOptions {
     // Artnet configuration.
     int artnet_universe;
     int artnet_channel;
+
+    // If multiple hosts send to us, the one currently driving keeps control
+    // until it has been silent for this many milliseconds; packets from
+    // others are dropped meanwhile. 0 lets every sender through.
+    int sender_timeout_ms;
+
+    // IPv4 address (e.g. "192.168.1.42") of a sender that can always take
+    // over control from others. NULL for none.
+    const char *priority_sender;
+
+    // Power limiting. Power is estimated in PWM units: the sum of all pixel
+    // channel values in a frame, each weighted with
+    // power_channel_weight[red, green, blue] / 256 (default 256 each, so an
+    // all-white pixel counts 765). This is reported as power_total to the
+    // PixelPusher clients.
+    // If power_budget is > 0, strips are scaled down proportionally once the
+    // power of their domain exceeds it. A power domain consists of
+    // strips_per_power_domain consecutive strips (0: all strips are in one
+    // domain).
+    int power_budget;
+    int strips_per_power_domain;
+    int power_channel_weight[3];
+
+    // E1.31 (sACN) input. If this is > 0, we also listen to sACN multicast
+    // starting with this universe. Each strip starts with a new universe and
+    // takes as many consecutive ones as needed with 170 pixels each.
+    int e131_universe;
+
+    // White extraction for RGBW strips (see OutputDevice::is_rgbw_strip()).
+    // The color of the white LED, given as the RGB value it matches, e.g.
+    // {255, 190, 130} for a warm white; the extracted white is compensated
+    // for that color temperature. Default is {255, 255, 255}.
+    int rgbw_white_point[3];
+    // How much of the white portion to move to the white LED, in 1/256.
+    // 256 (default) takes all of it, 0 leaves the white LED off.
+    int rgbw_white_amount;
+
+    // Path of a Unix domain socket where producers on the same host can
+    // connect to get frames to the server via shared memory instead of UDP
+    // (see pp-local-producer.h). NULL to disable.
+    const char *local_socket_path;
+
+    // If set, StartPixelPusherServer() returns right away and the server
+    // starts in the background as soon as the network interface is up,
+    // however long that takes. The options are still checked before
+    // returning; only problems with the network are reported later, on
+    // stderr. Call ShutdownPixelPusherServer() before trying again.
+    bool async_start;
 };
 
 // Start a PixelPusher server with the given options and and OutputDevice
 // implementation. Does not take over the ownership of the OutputDevice.
 // This returns 'true' after initialization, if the start was successful.
+// If the network interface has no address yet, this waits up to a minute for
+// it, unless PPOptions::async_start is set.
 // A running instance should be stopped by calling ShutdownPixelPusherServer().
 bool StartPixelPusherServer(const ::pp::PPOptions &options,
                             ::pp::OutputDevice *device);
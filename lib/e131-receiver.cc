@@ -0,0 +1,396 @@
+// -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+//  E1.31 (sACN) multicast receiver
+//
+//  Copyright (C) 2026 The pixelpusher-server authors
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "e131-receiver.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Relevant parts of ANSI E1.31-2016.
+static const uint16_t kE131Port = 5568;
+static const uint8_t kACNPacketIdentifier[12] = { 'A', 'S', 'C', '-',
+                                                  'E', '1', '.', '1',
+                                                  '7', 0, 0, 0 };
+static const uint32_t kVectorRootData = 0x00000004;
+static const uint32_t kVectorRootExtended = 0x00000008;
+static const uint32_t kVectorFramingData = 0x00000002;
+static const uint32_t kVectorExtendedSync = 0x00000001;
+static const uint8_t kVectorDMPSetProperty = 0x02;
+
+// Offsets into the packets.
+static const int kRootVectorOffset = 18;
+static const int kCIDOffset = 22;
+static const int kFramingVectorOffset = 40;
+static const int kPriorityOffset = 108;
+static const int kSyncAddressOffset = 109;
+static const int kSequenceOffset = 111;
+static const int kOptionsOffset = 112;
+static const int kUniverseOffset = 113;
+static const int kDMPVectorOffset = 117;
+static const int kPropertyCountOffset = 123;
+static const int kStartCodeOffset = 125;
+static const int kDMXDataOffset = 126;
+static const int kSyncPacketSize = 49;
+static const int kSyncPacketSequenceOffset = 44;
+static const int kSyncPacketAddressOffset = 45;
+
+static const uint8_t kOptionPreviewData = (1<<7);
+static const uint8_t kOptionStreamTerminated = (1<<6);
+
+static const int kMaxPriority = 200;
+static const int kMaxUniverse = 63999;
+static const int kMaxPacketSize = 638;
+static const int kPixelsPerUniverse = 170;    // 510 of the 512 channels.
+static const int64_t kSourceLossMicros = 2500000;  // E1.31 network loss timeout
+
+// Linux limits the multicast groups per socket to
+// net.ipv4.igmp_max_memberships, 20 by default.
+static const char kMaxMembershipsFile[] = "/proc/sys/net/ipv4/igmp_max_memberships";
+static const int kDefaultMaxMemberships = 20;
+
+#ifndef IP_MULTICAST_ALL
+#define IP_MULTICAST_ALL 49    // Linux >= 2.6.31, not in all libc headers.
+#endif
+
+static uint16_t ReadU16(const uint8_t *p) { return (p[0] << 8) | p[1]; }
+static uint32_t ReadU32(const uint8_t *p) {
+    return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+namespace pp {
+namespace internal {
+E131Receiver::E131Receiver(const ::pp::PPOptions &options, StripOutput *output,
+                           const struct in_addr &interface_address)
+    : first_universe_(options.e131_universe),
+      universes_per_strip_((output->pixels_per_strip() + kPixelsPerUniverse - 1)
+                           / kPixelsPerUniverse),
+      num_universes_(NumUniverses(output->num_strips(),
+                                  output->pixels_per_strip())),
+      interface_address_(interface_address),
+      output_(output),
+      universes_(new Universe[num_universes_]),
+      frame_buffer_(new uint8_t[3 * output->pixels_per_strip()
+                                * output->num_strips()]),
+      strips_(new StripOutput::Strip[output->num_strips()]),
+      sockets_(NULL), num_sockets_(0), sync_socket_(-1),
+      received_count_(0), sync_universe_(0), pending_sync_(0),
+      has_sync_source_(false), last_sync_sequence_(0) {
+    memset(sync_source_cid_, 0, sizeof(sync_source_cid_));
+    const int strip_bytes = 3 * output->pixels_per_strip();
+    memset(frame_buffer_, 0, strip_bytes * output->num_strips());
+
+    // Precompute where each universe goes, so that receiving is just a copy.
+    memset(universes_, 0, num_universes_ * sizeof(*universes_));
+    for (int i = 0; i < num_universes_; ++i) {
+        const int strip = i / universes_per_strip_;
+        const int universe_in_strip = i % universes_per_strip_;
+        const int pixel_offset = universe_in_strip * kPixelsPerUniverse;
+        const int pixels_left = output->pixels_per_strip() - pixel_offset;
+        universes_[i].offset = strip * strip_bytes + 3 * pixel_offset;
+        universes_[i].length = 3 * (pixels_left < kPixelsPerUniverse
+                                    ? pixels_left : kPixelsPerUniverse);
+    }
+    for (int i = 0; i < output->num_strips(); ++i) {
+        strips_[i].index = i;
+        strips_[i].rgb = frame_buffer_ + i * strip_bytes;
+    }
+}
+
+int E131Receiver::NumUniverses(int num_strips, int pixels_per_strip) {
+    return num_strips * ((pixels_per_strip + kPixelsPerUniverse - 1)
+                         / kPixelsPerUniverse);
+}
+
+E131Receiver::~E131Receiver() {
+    Stop();
+    WaitStopped();
+    for (int i = 0; i < num_sockets_; ++i) {
+        close(sockets_[i]);
+    }
+    delete [] sockets_;
+    delete [] strips_;
+    delete [] frame_buffer_;
+    delete [] universes_;
+}
+
+static int MaxMembershipsPerSocket() {
+    int result = kDefaultMaxMemberships;
+    FILE *f = fopen(kMaxMembershipsFile, "r");
+    if (f) {
+        if (fscanf(f, "%d", &result) != 1 || result < 1)
+            result = kDefaultMaxMemberships;
+        fclose(f);
+    }
+    return result;
+}
+
+// Create a socket bound to the E1.31 port that only gets the multicast
+// groups joined on it.
+static int CreateSocket() {
+    int s;
+    if ((s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)) < 0) {
+        perror("creating E1.31 socket");
+        return -1;
+    }
+    // Other sACN receivers on this host, as well as our other sockets,
+    // want to see the packets too.
+    int enable = 1;
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    // Otherwise, each socket gets the groups of all sockets on this host.
+    int disable = 0;
+    if (setsockopt(s, IPPROTO_IP, IP_MULTICAST_ALL,
+                   &disable, sizeof(disable)) < 0) {
+        perror("E1.31 socket: IP_MULTICAST_ALL");
+        close(s);
+        return -1;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(kE131Port);
+    if (bind(s, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        perror("bind E1.31");
+        close(s);
+        return -1;
+    }
+    return s;
+}
+
+bool E131Receiver::Init() {
+    // Each universe is one multicast group, plus one for the sync universe.
+    // Spread them over as many sockets as needed; the sync universe gets
+    // the slot after the last data universe.
+    const int per_socket = MaxMembershipsPerSocket();
+    num_sockets_ = num_universes_ / per_socket + 1;
+    sockets_ = new int[num_sockets_];
+    for (int i = 0; i < num_sockets_; ++i) {
+        sockets_[i] = -1;
+    }
+    for (int i = 0; i < num_sockets_; ++i) {
+        if ((sockets_[i] = CreateSocket()) < 0)
+            return false;
+    }
+    for (int i = 0; i < num_universes_; ++i) {
+        if (!JoinUniverse(sockets_[i / per_socket], first_universe_ + i, true))
+            return false;
+    }
+    sync_socket_ = sockets_[num_sockets_ - 1];
+    fprintf(stderr, "Listening for E1.31 universes %d..%d on port %d\n",
+            first_universe_, first_universe_ + num_universes_ - 1, kE131Port);
+    return true;
+}
+
+bool E131Receiver::JoinUniverse(int s, int universe, bool join) {
+    struct ip_mreq mreq;
+    memset(&mreq, 0, sizeof(mreq));
+    // Multicast address for each universe is 239.255.<hi>.<lo>
+    mreq.imr_multiaddr.s_addr = htonl((239 << 24) | (255 << 16) | universe);
+    mreq.imr_interface = interface_address_;
+    if (setsockopt(s, IPPROTO_IP, join ? IP_ADD_MEMBERSHIP : IP_DROP_MEMBERSHIP,
+                   &mreq, sizeof(mreq)) < 0) {
+        fprintf(stderr, "%s multicast group of E1.31 universe %d: %s\n",
+                join ? "Joining" : "Leaving", universe, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+void E131Receiver::FollowSyncUniverse(int sync_universe) {
+    if (sync_universe == sync_universe_)
+        return;
+    // Our data universes are joined all the time anyway.
+    const int last_universe = first_universe_ + num_universes_ - 1;
+    if (sync_universe_ != 0
+        && (sync_universe_ < first_universe_ || sync_universe_ > last_universe)) {
+        JoinUniverse(sync_socket_, sync_universe_, false);
+    }
+    if (sync_universe < first_universe_ || sync_universe > last_universe) {
+        JoinUniverse(sync_socket_, sync_universe, true);
+    }
+    sync_universe_ = sync_universe;
+}
+
+bool E131Receiver::AcceptSource(Universe *u, const uint8_t *packet,
+                                int64_t now) {
+    const uint8_t *cid = packet + kCIDOffset;
+    const uint8_t priority = packet[kPriorityOffset];
+    const uint8_t sequence = packet[kSequenceOffset];
+    const bool same_source = (u->has_source
+                              && memcmp(u->source_cid, cid, 16) == 0);
+    if (same_source) {
+        // Out of order or duplicate packet, as defined in E1.31 6.7.2
+        const int8_t diff = sequence - u->last_sequence;
+        if (diff <= 0 && diff > -20)
+            return false;
+    } else if (u->has_source
+               && now - u->last_seen_micros < kSourceLossMicros
+               && priority <= u->priority) {
+        return false;  // Someone else with at least our priority is sending.
+    }
+    if (packet[kOptionsOffset] & kOptionStreamTerminated) {
+        if (same_source) u->has_source = false;
+        return false;
+    }
+    u->has_source = true;
+    memcpy(u->source_cid, cid, 16);
+    u->priority = priority;
+    u->last_sequence = sequence;
+    u->last_seen_micros = now;
+    return true;
+}
+
+void E131Receiver::HandleDataPacket(const uint8_t *packet, int len) {
+    if (len < kDMXDataOffset
+        || ReadU32(packet + kFramingVectorOffset) != kVectorFramingData
+        || packet[kDMPVectorOffset] != kVectorDMPSetProperty
+        || packet[kStartCodeOffset] != 0          // Only DMX data.
+        || packet[kPriorityOffset] > kMaxPriority
+        || (packet[kOptionsOffset] & kOptionPreviewData)) {
+        return;
+    }
+    const int index = ReadU16(packet + kUniverseOffset) - first_universe_;
+    if (index < 0 || index >= num_universes_)
+        return;  // Not ours.
+
+    Universe *u = &universes_[index];
+    if (!AcceptSource(u, packet, MonotonicMicros()))
+        return;
+
+    const int sync_address = ReadU16(packet + kSyncAddressOffset);
+    if (sync_address == 0 && u->received) {
+        SendFrame();  // Unsynchronized sender started the next frame.
+    }
+
+    int data_len = ReadU16(packet + kPropertyCountOffset) - 1;  // -start code
+    if (data_len > len - kDMXDataOffset) data_len = len - kDMXDataOffset;
+    if (data_len > u->length) data_len = u->length;
+    if (data_len > 0) {
+        memcpy(frame_buffer_ + u->offset, packet + kDMXDataOffset, data_len);
+    }
+    if (!u->received) {
+        u->received = true;
+        ++received_count_;
+    }
+
+    if (sync_address != 0) {
+        pending_sync_ = sync_address;
+        if (sync_address <= kMaxUniverse) {
+            FollowSyncUniverse(sync_address);
+        }
+    } else {
+        pending_sync_ = 0;
+        if (received_count_ == num_universes_)
+            SendFrame();
+    }
+}
+
+void E131Receiver::HandleSyncPacket(const uint8_t *packet, int len) {
+    if (len < kSyncPacketSize
+        || ReadU32(packet + kFramingVectorOffset) != kVectorExtendedSync) {
+        return;
+    }
+    const int sync_address = ReadU16(packet + kSyncPacketAddressOffset);
+    if (received_count_ == 0 || sync_address != pending_sync_)
+        return;
+
+    // Only a source that sent some of the pending data can tell us to show it.
+    const uint8_t *cid = packet + kCIDOffset;
+    bool is_pending_source = false;
+    for (int i = 0; i < num_universes_ && !is_pending_source; ++i) {
+        const Universe &u = universes_[i];
+        is_pending_source = (u.received && u.has_source
+                             && memcmp(u.source_cid, cid, 16) == 0);
+    }
+    if (!is_pending_source)
+        return;
+
+    // Out of order or duplicate sync packet, same rule as for data.
+    const uint8_t sequence = packet[kSyncPacketSequenceOffset];
+    if (has_sync_source_ && memcmp(sync_source_cid_, cid, 16) == 0) {
+        const int8_t diff = sequence - last_sync_sequence_;
+        if (diff <= 0 && diff > -20)
+            return;
+    }
+    has_sync_source_ = true;
+    memcpy(sync_source_cid_, cid, 16);
+    last_sync_sequence_ = sequence;
+
+    SendFrame();
+}
+
+void E131Receiver::SendFrame() {
+    output_->SendFrame(strips_, output_->num_strips());
+    for (int i = 0; i < num_universes_; ++i) {
+        universes_[i].received = false;
+    }
+    received_count_ = 0;
+}
+
+void E131Receiver::Run() {
+    struct pollfd *fds = new struct pollfd[num_sockets_];
+    for (int i = 0; i < num_sockets_; ++i) {
+        fds[i].fd = sockets_[i];
+        fds[i].events = POLLIN;
+    }
+    uint8_t packet[kMaxPacketSize];
+    while (running()) {
+        // Wake up every now and then to see if we should stop.
+        if (poll(fds, num_sockets_, 500) <= 0)
+            continue;
+        for (int i = 0; i < num_sockets_; ++i) {
+            if (fds[i].revents == 0)
+                continue;
+            ssize_t len = recvfrom(fds[i].fd, packet, sizeof(packet),
+                                   MSG_DONTWAIT, NULL, 0);
+            if (len < 0) {
+                if (errno != EAGAIN) perror("E1.31 receive problem");
+                continue;
+            }
+            HandlePacket(packet, len);
+        }
+    }
+    delete [] fds;
+}
+
+void E131Receiver::HandlePacket(const uint8_t *packet, int len) {
+    if (len < kRootVectorOffset + 4
+        || ReadU16(packet) != 0x0010  // preamble size
+        || memcmp(packet + 4, kACNPacketIdentifier,
+                  sizeof(kACNPacketIdentifier)) != 0) {
+        return;
+    }
+    switch (ReadU32(packet + kRootVectorOffset)) {
+    case kVectorRootData:
+        HandleDataPacket(packet, len);
+        break;
+    case kVectorRootExtended:
+        HandleSyncPacket(packet, len);
+        break;
+    default:
+        break;   // E.g. universe discovery. Not interested.
+    }
+}
+}  // namespace internal
+}  // namespace pp
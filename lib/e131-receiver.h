@@ -0,0 +1,108 @@
+// -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+//  E1.31 (sACN) multicast receiver
+//
+//  Copyright (C) 2026 The pixelpusher-server authors
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef PP_E131_RECEIVER_H
+#define PP_E131_RECEIVER_H
+
+#include <stdint.h>
+#include <netinet/in.h>
+
+#include "pp-server.h"
+#include "pp-thread.h"
+#include "strip-output.h"
+
+namespace pp {
+namespace internal {
+// Receives E1.31 (sACN) multicast and sends it to the StripOutput.
+//
+// Each strip starts at a new universe and takes as many consecutive
+// universes as needed with 170 RGB pixels each, beginning with
+// PPOptions::e131_universe for strip 0.
+//
+// Of multiple sources sending the same universe, the one with the highest
+// priority wins. Data that references a synchronization universe is shown
+// when the sync packet arrives; otherwise, a frame is shown as soon as all
+// universes have been received.
+class E131Receiver : public StoppableThread {
+public:
+    // Multicast groups are joined on the interface with the given address.
+    E131Receiver(const ::pp::PPOptions &options, StripOutput *output,
+                 const struct in_addr &interface_address);
+    virtual ~E131Receiver();
+
+    // Create the sockets and join the multicast groups. Call before Start().
+    // Linux limits the groups per socket, so we use as many as needed.
+    bool Init();
+
+    // Number of universes needed for the given strips.
+    static int NumUniverses(int num_strips, int pixels_per_strip);
+
+    // Number of universes we listen to.
+    int num_universes() const { return num_universes_; }
+
+    virtual void Run();
+
+private:
+    // Where the data of each universe goes in our frame buffer, as well as
+    // the state of the source currently sending it.
+    struct Universe {
+        int offset;           // Byte offset in frame_buffer_
+        int length;           // Bytes of pixel data in this universe.
+        bool received;        // Received since last time we sent a frame.
+
+        bool has_source;
+        uint8_t source_cid[16];
+        uint8_t priority;
+        uint8_t last_sequence;
+        int64_t last_seen_micros;
+    };
+
+    // Join or leave the multicast group of the universe on socket "s".
+    bool JoinUniverse(int s, int universe, bool join);
+    // Change the sync universe we listen to.
+    void FollowSyncUniverse(int sync_universe);
+    void HandlePacket(const uint8_t *packet, int len);
+    void HandleDataPacket(const uint8_t *packet, int len);
+    void HandleSyncPacket(const uint8_t *packet, int len);
+
+    // Accept the source of this packet for the universe? Updates the source.
+    bool AcceptSource(Universe *u, const uint8_t *packet, int64_t now);
+    void SendFrame();
+
+    const int first_universe_;
+    const int universes_per_strip_;
+    const int num_universes_;
+    const struct in_addr interface_address_;
+    StripOutput *const output_;
+    Universe *universes_;
+    uint8_t *frame_buffer_;
+    StripOutput::Strip *strips_;
+    int *sockets_;
+    int num_sockets_;
+    int sync_socket_;         // The one with room for the sync universe.
+    int received_count_;
+    int sync_universe_;       // the one we have joined; 0 for none.
+    int pending_sync_;        // sync universe our frame data waits for.
+    bool has_sync_source_;    // Source of the last sync packet applied.
+    uint8_t sync_source_cid_[16];
+    uint8_t last_sync_sequence_;
+};
+}  // namespace internal
+}  // namespace pp
+
+#endif  // PP_E131_RECEIVER_H
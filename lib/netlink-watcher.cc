@@ -0,0 +1,96 @@
+// -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+//  Watching network interface changes with rtnetlink
+//
+//  Copyright (C) 2026 The pixelpusher-server authors
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "netlink-watcher.h"
+
+#include <errno.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace pp {
+namespace internal {
+NetlinkWatcher::NetlinkWatcher() : fd_(-1) {}
+
+NetlinkWatcher::~NetlinkWatcher() {
+    if (fd_ >= 0) close(fd_);
+}
+
+bool NetlinkWatcher::Open() {
+    if ((fd_ = socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                      NETLINK_ROUTE)) < 0) {
+        perror("netlink socket");
+        return false;
+    }
+    struct sockaddr_nl addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR;
+    if (bind(fd_, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        perror("netlink bind");
+        close(fd_);
+        fd_ = -1;
+        return false;
+    }
+    return true;
+}
+
+bool NetlinkWatcher::WaitForEvent(int timeout_ms) {
+    if (fd_ < 0) {
+        struct timespec sleep_time = { timeout_ms / 1000,
+                                       (timeout_ms % 1000) * 1000000 };
+        nanosleep(&sleep_time, NULL);
+        return true;
+    }
+    struct pollfd p = { fd_, POLLIN, 0 };
+    if (poll(&p, 1, timeout_ms) <= 0)
+        return false;
+
+    // We only care that something changed, not what it was; the caller
+    // looks at the interface again anyway. So just see if there is any
+    // link or address message and drain the socket.
+    bool got_event = false;
+    char buffer[8192] __attribute__((aligned(NLMSG_ALIGNTO)));
+    ssize_t len;
+    while ((len = recv(fd_, buffer, sizeof(buffer), 0)) != 0) {
+        if (len < 0) {
+            // Kernel dropped messages because we were too slow; we don't
+            // know what we missed, so better look.
+            if (errno == ENOBUFS) got_event = true;
+            if (errno == EINTR || errno == ENOBUFS) continue;
+            break;  // EAGAIN: all read.
+        }
+        for (struct nlmsghdr *msg = (struct nlmsghdr *) buffer;
+             NLMSG_OK(msg, (size_t) len); msg = NLMSG_NEXT(msg, len)) {
+            switch (msg->nlmsg_type) {
+            case RTM_NEWLINK: case RTM_DELLINK:
+            case RTM_NEWADDR: case RTM_DELADDR:
+                got_event = true;
+                break;
+            }
+        }
+    }
+    return got_event;
+}
+}  // namespace internal
+}  // namespace pp
@@ -0,0 +1,47 @@
+// -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+//  Watching network interface changes with rtnetlink
+//
+//  Copyright (C) 2026 The pixelpusher-server authors
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef PP_NETLINK_WATCHER_H
+#define PP_NETLINK_WATCHER_H
+
+namespace pp {
+namespace internal {
+// Get notified by the kernel (rtnetlink) when network links or IPv4
+// addresses change, so that we don't have to poll.
+class NetlinkWatcher {
+public:
+    NetlinkWatcher();
+    ~NetlinkWatcher();
+
+    // Subscribe to link and address events. Returns false if that is not
+    // possible; WaitForEvent() then falls back to polling.
+    bool Open();
+
+    // Wait up to "timeout_ms" for a link or address event. Returns true if
+    // there was one. Events that arrived in the meantime are all consumed.
+    // Without a netlink subscription, this sleeps for the timeout and
+    // returns true, as we can't tell if something changed.
+    bool WaitForEvent(int timeout_ms);
+
+private:
+    int fd_;
+};
+}  // namespace internal
+}  // namespace pp
+
+#endif  // PP_NETLINK_WATCHER_H
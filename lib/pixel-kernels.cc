@@ -0,0 +1,272 @@
+// -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+//  Vectorized bulk operations on pixel data
+//
+//  Copyright (C) 2026 The pixelpusher-server authors
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "pixel-kernels.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+// GCC/Clang vector extensions. These map to NEON on ARM and SSE/AVX on x86,
+// so we don't have to write the same thing twice with intrinsics.
+typedef uint8_t v16u8 __attribute__((vector_size(16)));
+typedef uint16_t v16u16 __attribute__((vector_size(32)));
+typedef uint32_t v16u32 __attribute__((vector_size(64)));
+
+static inline v16u8 LoadV16(const uint8_t *p) {
+    v16u8 result;
+    memcpy(&result, p, sizeof(result));   // Unaligned load.
+    return result;
+}
+
+static inline void StoreV16(uint8_t *p, v16u8 v) {
+    memcpy(p, &v, sizeof(v));
+}
+
+// Byte shuffle of two vectors with a constant mask; indices 16..31 pick from
+// "b". The compilers spell this differently.
+#if defined(__clang__)
+#  define SHUFFLE_V16(a, b, ...) __builtin_shufflevector(a, b, __VA_ARGS__)
+#else
+#  define SHUFFLE_V16(a, b, ...) __builtin_shuffle(a, b, (v16u8){__VA_ARGS__})
+#endif
+
+// Channel orders for ShufflePixels(): rearrange a group of four packed RGB
+// pixels (the first 12 bytes of the vector) into kBytesPerPixel bytes each.
+struct RGBToGRBOrder {
+    enum { kBytesPerPixel = 3 };
+    static v16u8 Shuffle(v16u8 rgb) {
+        return SHUFFLE_V16(rgb, rgb,
+                           1, 0, 2,  4, 3, 5,  7, 6, 8,  10, 9, 11,
+                           12, 13, 14, 15);
+    }
+};
+
+struct RGBToAPA102Order {
+    enum { kBytesPerPixel = 4 };
+    static v16u8 Shuffle(v16u8 rgb) {
+        // 0b111 marker + 5 bit global brightness, then blue, green, red.
+        const v16u8 marker = (v16u8){0} + 0xFF;
+        return SHUFFLE_V16(rgb, marker,
+                           16, 2, 1, 0,  16, 5, 4, 3,  16, 8, 7, 6,
+                           16, 11, 10, 9);
+    }
+};
+
+template <typename T, typename V>
+static void DitherLevelsImpl(const uint16_t *in, int len, int bits,
+                             uint8_t *error, T *out) {
+    // The input in 1/256 of output levels is in * max_level / 255, rounded,
+    // with max_level = 2^bits - 1. With 16 bit output, this needs all of
+    // 32 bit. Multiplications with 2^n - 1 are done with shifts, as not all
+    // instruction sets multiply 32 bit lanes. There is no vector division
+    // either, so we estimate x / 255 with shifts (which is exact or one
+    // short for all x we can see here) and correct that.
+    // The full input range maps to exactly 256 * max_level, so adding the
+    // error (< 256) never exceeds max_level and there is no need to clamp.
+    const uint32_t max_level = (1 << bits) - 1;
+    for (/**/; len >= 16; len -= 16, in += 16, error += 16, out += 16) {
+        v16u16 in_values;
+        memcpy(&in_values, in, sizeof(in_values));
+        const v16u32 wide = __builtin_convertvector(in_values, v16u32);
+        const v16u32 x = (wide << bits) - wide + 127;
+        v16u32 scaled = (x + (x >> 8) + (x >> 16) + (x >> 24)) >> 8;
+        // The remainder is below 2 * 255, so this adds one where it is
+        // still >= 255.
+        scaled += (x - ((scaled << 8) - scaled) + 1) >> 8;
+        const v16u32 value = scaled
+            + __builtin_convertvector(LoadV16(error), v16u32);
+        StoreV16(error, __builtin_convertvector(value & 0xff, v16u8));
+        const V levels = __builtin_convertvector(value >> 8, V);
+        memcpy(out, &levels, sizeof(levels));
+    }
+    for (int i = 0; i < len; ++i) {
+        const uint32_t value = (in[i] * max_level + 127) / 255 + error[i];
+        error[i] = value & 0xff;
+        out[i] = value >> 8;
+    }
+}
+
+namespace pp {
+namespace internal {
+void SumChannels(const uint8_t *rgb, int pixel_count, uint32_t sums[3]) {
+    sums[0] = sums[1] = sums[2] = 0;
+
+    // We go through 16 pixels (48 bytes = three vectors) at a time. Each
+    // lane in the three accumulators always sees the same color channel.
+    // The 16 bit accumulators can take 257 additions of 255 before they
+    // overflow, so we flush them to the 32 bit sums well before that.
+    static const int kPixelsPerBlock = 16;
+    static const int kBlocksBeforeFlush = 256;
+    int blocks = pixel_count / kPixelsPerBlock;
+    while (blocks > 0) {
+        const int run = blocks < kBlocksBeforeFlush ? blocks : kBlocksBeforeFlush;
+        v16u16 acc[3] = { {0}, {0}, {0} };
+        for (int b = 0; b < run; ++b) {
+            acc[0] += __builtin_convertvector(LoadV16(rgb +  0), v16u16);
+            acc[1] += __builtin_convertvector(LoadV16(rgb + 16), v16u16);
+            acc[2] += __builtin_convertvector(LoadV16(rgb + 32), v16u16);
+            rgb += 3 * kPixelsPerBlock;
+        }
+        for (int v = 0; v < 3; ++v) {
+            for (int lane = 0; lane < 16; ++lane) {
+                sums[(16 * v + lane) % 3] += acc[v][lane];
+            }
+        }
+        blocks -= run;
+    }
+
+    for (int i = 0; i < pixel_count % kPixelsPerBlock; ++i) {
+        sums[0] += *rgb++;
+        sums[1] += *rgb++;
+        sums[2] += *rgb++;
+    }
+}
+
+void ScaleBytes(const uint8_t *in, uint8_t *out, int len, uint16_t factor) {
+    const v16u16 vfactor = (v16u16){0} + factor;
+    for (/**/; len >= 16; len -= 16, in += 16, out += 16) {
+        v16u16 wide = __builtin_convertvector(LoadV16(in), v16u16);
+        wide = (wide * vfactor) >> 8;
+        StoreV16(out, __builtin_convertvector(wide, v16u8));
+    }
+    for (int i = 0; i < len; ++i) {
+        out[i] = (in[i] * factor) >> 8;
+    }
+}
+
+// With a constant mask, this is a single byte permute on NEON or SSSE3. Baseline
+// x86-64 (SSE2) has no byte permute, so there it ends up as byte moves.
+template <typename Order>
+static void ShufflePixels(const uint8_t *rgb, int pixel_count, uint8_t *out) {
+    const int out_group_bytes = 4 * Order::kBytesPerPixel;
+    // The vector load reads 16 bytes, but a group is only 12 bytes. The
+    // last group is copied to a buffer first, so that we don't read beyond
+    // the input.
+    int groups = pixel_count / 4;
+    for (/**/; groups > 1; --groups, rgb += 12, out += out_group_bytes) {
+        const v16u8 result = Order::Shuffle(LoadV16(rgb));
+        memcpy(out, &result, out_group_bytes);
+    }
+    const int remaining_pixels = 4 * groups + pixel_count % 4;
+    if (remaining_pixels > 0) {
+        uint8_t last_in[32] = {0};  // up to 7 pixels + vector load slack.
+        memcpy(last_in, rgb, 3 * remaining_pixels);
+        for (int done = 0; done < remaining_pixels; done += 4) {
+            const v16u8 result = Order::Shuffle(LoadV16(last_in + 3 * done));
+            const int pixels = std::min(4, remaining_pixels - done);
+            memcpy(out, &result, pixels * Order::kBytesPerPixel);
+            out += out_group_bytes;
+        }
+    }
+}
+
+void RGBToGRB(const uint8_t *rgb, int pixel_count, uint8_t *grb) {
+    ShufflePixels<RGBToGRBOrder>(rgb, pixel_count, grb);
+}
+
+void RGBToAPA102(const uint8_t *rgb, int pixel_count, uint8_t *out) {
+    ShufflePixels<RGBToAPA102Order>(rgb, pixel_count, out);
+}
+
+void ExtractWhite(const uint8_t *rgb, int pixel_count,
+                  const WhiteExtraction &params, uint8_t *rgbw) {
+    // Channels of 16 pixels at a time are pulled apart into one vector each,
+    // and the arithmetic is done on all of them at once.
+    const v16u32 max_value = (v16u32){0} + 255;
+    const v16u32 amount = (v16u32){0} + params.amount;
+    v16u32 inverse[3], white_point[3];
+    for (int c = 0; c < 3; ++c) {
+        inverse[c] = (v16u32){0} + params.inverse[c];
+        white_point[c] = (v16u32){0} + params.white_point[c];
+    }
+    uint8_t block_in[3 * 16] = {0};
+    uint8_t block_out[4 * 16];
+    for (int done = 0; done < pixel_count; done += 16) {
+        const int pixels = std::min(16, pixel_count - done);
+        memcpy(block_in, rgb + 3 * done, 3 * pixels);
+        v16u32 color[3];
+        for (int i = 0; i < 16; ++i) {
+            color[0][i] = block_in[3 * i + 0];
+            color[1][i] = block_in[3 * i + 1];
+            color[2][i] = block_in[3 * i + 2];
+        }
+
+        // How much white can we take out, limited by each channel ?
+        v16u32 white = max_value;
+        for (int c = 0; c < 3; ++c) {
+            const v16u32 possible = (color[c] * inverse[c]) >> 8;
+            white = (possible < white) ? possible : white;
+        }
+        white = (white * amount) >> 8;
+
+        // Remove what the white LED now provides: white * white_point / 255.
+        // (x + 1 + (x >> 8)) >> 8 is the exact x / 255 for x up to 255 * 255.
+        for (int c = 0; c < 3; ++c) {
+            const v16u32 provided = white * white_point[c];
+            color[c] -= (provided + 1 + (provided >> 8)) >> 8;
+        }
+
+        for (int i = 0; i < 16; ++i) {
+            block_out[4 * i + 0] = color[0][i];
+            block_out[4 * i + 1] = color[1][i];
+            block_out[4 * i + 2] = color[2][i];
+            block_out[4 * i + 3] = white[i];
+        }
+        memcpy(rgbw + 4 * done, block_out, 4 * pixels);
+    }
+}
+
+void BlendBytes(const uint8_t *from, const uint8_t *to, int len,
+                uint16_t alpha, uint16_t *out) {
+    // Both weights add up to 256, so the result is at most 255 * 256 and
+    // everything fits in 16 bit.
+    const v16u16 to_weight = (v16u16){0} + alpha;
+    const v16u16 from_weight = (v16u16){0} + (uint16_t)(256 - alpha);
+    for (/**/; len >= 16; len -= 16, from += 16, to += 16, out += 16) {
+        const v16u16 result
+            = __builtin_convertvector(LoadV16(from), v16u16) * from_weight
+            + __builtin_convertvector(LoadV16(to), v16u16) * to_weight;
+        memcpy(out, &result, sizeof(result));
+    }
+    for (int i = 0; i < len; ++i) {
+        out[i] = from[i] * (256 - alpha) + to[i] * alpha;
+    }
+}
+
+void DitherLevels(const uint16_t *in, int len, int bits,
+                  uint8_t *error, uint16_t *out) {
+    DitherLevelsImpl<uint16_t, v16u16>(in, len, bits, error, out);
+}
+
+void DitherLevels(const uint16_t *in, int len, int bits,
+                  uint8_t *error, uint8_t *out) {
+    DitherLevelsImpl<uint8_t, v16u8>(in, len, bits, error, out);
+}
+
+void SevenBitHighSet(uint8_t *data, int len) {
+    const v16u8 high_bit = (v16u8){0} + 0x80;
+    for (/**/; len >= 16; len -= 16, data += 16) {
+        StoreV16(data, (LoadV16(data) >> 1) | high_bit);
+    }
+    for (int i = 0; i < len; ++i) {
+        data[i] = (data[i] >> 1) | 0x80;
+    }
+}
+}  // namespace internal
+}  // namespace pp
@@ -0,0 +1,81 @@
+// -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+//  Vectorized bulk operations on pixel data
+//
+//  Copyright (C) 2026 The pixelpusher-server authors
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Bulk operations on pixel data that are called for every received strip,
+// so they are written with (portable) vector operations.
+
+#ifndef PP_PIXEL_KERNELS_H
+#define PP_PIXEL_KERNELS_H
+
+#include <stdint.h>
+
+namespace pp {
+namespace internal {
+// Sum up the red, green and blue values of "pixel_count" pixels in "rgb",
+// which are packed RGB triplets. Results end up in sums[0..2].
+void SumChannels(const uint8_t *rgb, int pixel_count, uint32_t sums[3]);
+
+// Multiply each of the "len" bytes in "in" with factor/256 and write the
+// result to "out" (which can be the same as "in"). The factor must not be
+// larger than 256.
+void ScaleBytes(const uint8_t *in, uint8_t *out, int len, uint16_t factor);
+
+// Reorder "pixel_count" packed RGB pixels to GRB, as WS2812 and LPD8806
+// want them.
+void RGBToGRB(const uint8_t *rgb, int pixel_count, uint8_t *grb);
+
+// Convert "pixel_count" packed RGB pixels to APA102 LED frames: four bytes
+// per pixel, 0xFF (full global brightness) followed by blue, green, red.
+void RGBToAPA102(const uint8_t *rgb, int pixel_count, uint8_t *out);
+
+// Parameters for ExtractWhite(), derived from the color of the white LED.
+struct WhiteExtraction {
+    uint32_t white_point[3];  // RGB of the white LED, each 1..255.
+    uint32_t inverse[3];      // (255 << 8) / white_point[c]
+    uint32_t amount;          // Portion of white to extract in 1/256.
+};
+
+// Convert "pixel_count" packed RGB pixels to RGBW. The white portion of each
+// pixel (relative to the white point) is moved to the white channel.
+void ExtractWhite(const uint8_t *rgb, int pixel_count,
+                  const WhiteExtraction &params, uint8_t *rgbw);
+
+// Blend "len" bytes of "from" and "to": out = from * (256 - alpha) + to * alpha,
+// which is the 8.8 fixed point value of the interpolation. The weight
+// "alpha" of "to" is 0..256.
+void BlendBytes(const uint8_t *from, const uint8_t *to, int len,
+                uint16_t alpha, uint16_t *out);
+
+// Temporal dithering of "len" 8.8 fixed point values as produced by
+// BlendBytes() down to whole output levels with the given number of bits
+// (8..16); input 255 maps exactly to the highest level (1 << bits) - 1.
+// The fraction that doesn't make it into the output level is kept in
+// "error" (one byte per value) and added next time, so that over time the
+// average output matches the input.
+void DitherLevels(const uint16_t *in, int len, int bits,
+                  uint8_t *error, uint16_t *out);
+void DitherLevels(const uint16_t *in, int len, int bits,
+                  uint8_t *error, uint8_t *out);
+
+// Turn each of the "len" bytes of "data" into a 7 bit value with the high
+// bit set.
+void SevenBitHighSet(uint8_t *data, int len);
+}  // namespace internal
+}  // namespace pp
+
+#endif  // PP_PIXEL_KERNELS_H
@@ -0,0 +1,87 @@
+// -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+//  Power estimation and limiting of frames
+//
+//  Copyright (C) 2026 The pixelpusher-server authors
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "power-limiter.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "pixel-kernels.h"
+
+namespace pp {
+namespace internal {
+PowerLimiter::PowerLimiter(const ::pp::PPOptions &options,
+                           int num_strips, int pixels_per_strip)
+    : num_strips_(num_strips), pixels_per_strip_(pixels_per_strip),
+      strips_per_domain_(options.strips_per_power_domain > 0
+                         ? options.strips_per_power_domain
+                         : (num_strips > 0 ? num_strips : 1)),
+      num_domains_((num_strips + strips_per_domain_ - 1) / strips_per_domain_),
+      budget_(options.power_budget > 0 ? options.power_budget : 0),
+      strip_power_(new uint64_t[num_strips]) {
+    for (int c = 0; c < 3; ++c) {
+        weight_[c] = (options.power_channel_weight[c] > 0
+                      ? options.power_channel_weight[c] : 0);
+    }
+    memset(strip_power_, 0, num_strips * sizeof(*strip_power_));
+}
+
+PowerLimiter::~PowerLimiter() {
+    delete [] strip_power_;
+}
+
+void PowerLimiter::UpdateStrip(int strip, const uint8_t *rgb) {
+    if (strip < 0 || strip >= num_strips_) return;
+    uint32_t sums[3];
+    SumChannels(rgb, pixels_per_strip_, sums);
+    strip_power_[strip] = ((uint64_t)sums[0] * weight_[0]
+                           + (uint64_t)sums[1] * weight_[1]
+                           + (uint64_t)sums[2] * weight_[2]) >> 8;
+}
+
+const uint8_t *PowerLimiter::LimitStrip(int strip, const uint8_t *rgb,
+                                        uint8_t *scratch) {
+    if (budget_ == 0 || strip < 0 || strip >= num_strips_) return rgb;
+    const int first = DomainOf(strip) * strips_per_domain_;
+    const int end = std::min(first + strips_per_domain_, num_strips_);
+    uint64_t domain_power = 0;
+    for (int i = first; i < end; ++i) {
+        domain_power += strip_power_[i];
+    }
+    if (domain_power <= budget_) return rgb;
+    // Round down, so that we end up below budget.
+    const uint16_t factor = (budget_ << 8) / domain_power;
+    ScaleBytes(rgb, scratch, 3 * pixels_per_strip_, factor);
+    return scratch;
+}
+
+uint32_t PowerLimiter::power_total() const {
+    uint64_t total = 0;
+    for (int d = 0; d < num_domains_; ++d) {
+        uint64_t domain_power = 0;
+        for (int i = d * strips_per_domain_;
+             i < num_strips_ && i < (d + 1) * strips_per_domain_; ++i) {
+            domain_power += strip_power_[i];
+        }
+        total += (budget_ > 0 && domain_power > budget_) ? budget_ : domain_power;
+    }
+    return total > UINT32_MAX ? UINT32_MAX : total;
+}
+}  // namespace internal
+}  // namespace pp
@@ -0,0 +1,70 @@
+// -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+//  Power estimation and limiting of frames
+//
+//  Copyright (C) 2026 The pixelpusher-server authors
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef PP_POWER_LIMITER_H
+#define PP_POWER_LIMITER_H
+
+#include <stdint.h>
+
+#include "pp-server.h"
+
+namespace pp {
+namespace internal {
+// Estimates the power drawn by the current frame and scales down strips
+// whose power domain would exceed the configured budget.
+//
+// Power is counted in PWM units: the sum of all channel values, each
+// weighted with its PPOptions::power_channel_weight / 256.
+//
+// Not all strips need to arrive with each packet, so we remember the
+// estimate of each strip and look at the whole domain when deciding on the
+// scale factor for the strips just received.
+class PowerLimiter {
+public:
+    PowerLimiter(const ::pp::PPOptions &options,
+                 int num_strips, int pixels_per_strip);
+    ~PowerLimiter();
+
+    // Update the power estimate of the given strip with new pixel data
+    // ("rgb" being packed RGB triplets of pixels_per_strip pixels).
+    // Call this for all strips of a packet before calling LimitStrip().
+    void UpdateStrip(int strip, const uint8_t *rgb);
+
+    // If the power domain of the strip is over budget, scale the pixel data
+    // into "scratch" (room for pixels_per_strip pixels) and return that.
+    // Otherwise, just return "rgb".
+    const uint8_t *LimitStrip(int strip, const uint8_t *rgb, uint8_t *scratch);
+
+    // Estimated power of all strips after limiting.
+    uint32_t power_total() const;
+
+private:
+    int DomainOf(int strip) const { return strip / strips_per_domain_; }
+
+    const int num_strips_;
+    const int pixels_per_strip_;
+    const int strips_per_domain_;
+    const int num_domains_;
+    const uint64_t budget_;     // per domain. 0 for unlimited.
+    uint32_t weight_[3];
+    uint64_t *strip_power_;     // unlimited estimate for each strip.
+};
+}  // namespace internal
+}  // namespace pp
+
+#endif  // PP_POWER_LIMITER_H
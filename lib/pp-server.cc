@@ -18,25 +18,34 @@
 
 #include <arpa/inet.h>
 #include <assert.h>
+#include <errno.h>
 #include <getopt.h>
 #include <limits.h>
 #include <linux/netdevice.h>
 #include <netinet/in.h>
+#include <poll.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
-#include <sys/time.h>
 #include <sys/types.h>
+#include <sys/un.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <algorithm>
 
+#include "pp-local-producer.h"
 #include "pp-server.h"
 
+#include "e131-receiver.h"
+#include "netlink-watcher.h"
 #include "pp-thread.h"
+#include "sender-arbiter.h"
+#include "strip-output.h"
 #include "universal-discovery-protocol.h"
 
 using namespace pp::internal;
@@ -61,18 +70,12 @@ static const int kDefaultUDPPacketSize = 1460;
 // don't really need more update rate than this.
 static const uint32_t kMinUpdatePeriodUSec = 16666 / 9;
 
-static int64_t CurrentTimeMicros() {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    int64_t result = tv.tv_sec;
-    return result * 1000000 + tv.tv_usec;
-}
-
 // Given the name of the interface, such as "eth0", fill the IP address and
 // broadcast address into "header"
 // Some socket and ioctl nastiness.
+// If "verbose", print problems and the result.
 static bool DetermineNetwork(const char *interface,
-                             DiscoveryPacketHeader *header) {
+                             DiscoveryPacketHeader *header, bool verbose) {
     int s;
     if ((s = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
         return false;
@@ -88,7 +91,7 @@ static bool DetermineNetwork(const char *interface,
             memcpy(header->mac_address,  mac_addr_query.ifr_hwaddr.sa_data,
                    sizeof(header->mac_address));
         } else {
-            perror("Getting hardware address");
+            if (verbose) perror("Getting hardware address");
             success = false;
         }
     }
@@ -100,13 +103,16 @@ static bool DetermineNetwork(const char *interface,
             struct sockaddr_in *s_in = (struct sockaddr_in *) &ip_addr_query.ifr_addr;
             memcpy(header->ip_address, &s_in->sin_addr, sizeof(header->ip_address));
         } else {
-            perror("Getting IP address");
+            if (verbose) perror("Getting IP address");
             success = false;
         }
     }
 
     close(s);
 
+    if (!verbose)
+        return success;
+
     // Let's print what we're sending.
     char buf[256];
     inet_ntop(AF_INET, header->ip_address, buf, sizeof(buf));
@@ -119,40 +125,62 @@ static bool DetermineNetwork(const char *interface,
     return success;
 }
 
-namespace {
-// Threads deriving from this should exit Run() as soon as they see !running_
-class StoppableThread : public Thread {
-public:
-    StoppableThread() : running_(true) {}
-    virtual ~StoppableThread() { Stop(); }
-
-    // Cause stopping wait until we're done.
-    void Stop() {
-        MutexLock l(&run_mutex_);
-        running_ = false;
+// Get the MTU of the given interface. Returns -1 if it can't be determined.
+static int DetermineMTU(const char *interface) {
+    int s;
+    if ((s = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
+        return -1;
     }
+    struct ifreq mtu_query;
+    memset(&mtu_query, 0, sizeof(mtu_query));
+    strncpy(mtu_query.ifr_name, interface, sizeof(mtu_query.ifr_name) - 1);
+    const int result = (ioctl(s, SIOCGIFMTU, &mtu_query) == 0)
+        ? mtu_query.ifr_mtu : -1;
+    close(s);
+    return result;
+}
 
-protected:
-    bool running() { MutexLock l(&run_mutex_); return running_; }
+// The largest UDP payload that goes over a link with the given MTU without
+// being fragmented.
+static int UDPPacketSizeForMTU(int mtu) {
+    const int kIPv4AndUDPHeaderSize = 20 + 8;
+    return std::min(mtu - kIPv4AndUDPHeaderSize, kMaxUDPPacketSize);
+}
 
-private:
-    Mutex run_mutex_;
-    bool running_;
-};
+// Number of strips we can accept in one packet of the given size.
+static int MaxStripsPerPacket(int udp_packet_size, int pixels_per_strip,
+                              int number_of_strips) {
+    const int usable_packet_size = udp_packet_size - 4;  // 4 bytes seq#
+    // Whatever fits in one packet, but not more than one 'frame'.
+    return std::min(usable_packet_size / (1 + 3 * pixels_per_strip),
+                    number_of_strips);
+}
+
+// Check that at least one strip fits in a packet of the given size.
+static bool PacketFitsStrip(int udp_packet_size, int pixels_per_strip) {
+    if (MaxStripsPerPacket(udp_packet_size, pixels_per_strip, 1) > 0)
+        return true;
+    fprintf(stderr, "Packet size limit (%d Bytes) smaller than needed to "
+            "transmit one row (%d Bytes). Change UDP packet size.\n",
+            udp_packet_size - 4, (1 + 3 * pixels_per_strip));
+    return false;
+}
 
+namespace {
 // Broadcast every second the discovery protocol.
 class Beacon : public StoppableThread {
 public:
     Beacon(const DiscoveryPacketHeader &header,
-           const PixelPusherContainer &pixel_pusher)
-        : header_(header), pixel_pusher_(pixel_pusher),
+           const PixelPusherContainer &pixel_pusher,
+           StripOutput *output, int mtu)
+        : header_(header), pixel_pusher_(pixel_pusher), output_(output),
+          mtu_(mtu),
           pixel_pusher_base_size_(CalcPixelPusherBaseSize(pixel_pusher_.base
                                                           ->strips_attached)),
           discovery_packet_size_(sizeof(header_)
                                  + pixel_pusher_base_size_
                                  + sizeof(pixel_pusher_.ext)),
-          discovery_packet_buffer_(new uint8_t[discovery_packet_size_]),
-          previous_sequence_(-1) {
+          discovery_packet_buffer_(new uint8_t[discovery_packet_size_]) {
         fprintf(stderr, "discovery packet size: %zd\n", discovery_packet_size_);
     }
 
@@ -161,15 +189,50 @@ public:
         delete [] discovery_packet_buffer_;
     }
 
-    void UpdatePacketStats(uint32_t seen_sequence, uint32_t update_micros) {
+    // Update stats after a packet from "driver" has been applied. The
+    // "missed_packets" are the gaps in the sequence numbers of that driver.
+    void UpdatePacketStats(const struct sockaddr_in &driver,
+                           uint32_t missed_packets, uint32_t update_micros) {
         MutexLock l(&mutex_);
         pixel_pusher_.base->update_period = (update_micros < kMinUpdatePeriodUSec
                                              ? kMinUpdatePeriodUSec
                                              : update_micros);
-        const int32_t sequence_diff = seen_sequence - previous_sequence_ - 1;
-        if (sequence_diff > 0)
-            pixel_pusher_.base->delta_sequence += sequence_diff;
-        previous_sequence_ = seen_sequence;
+        pixel_pusher_.base->delta_sequence += missed_packets;
+        memcpy(pixel_pusher_.ext.last_driven_ip, &driver.sin_addr,
+               sizeof(pixel_pusher_.ext.last_driven_ip));
+        pixel_pusher_.ext.last_driven_port = ntohs(driver.sin_port);
+    }
+
+    // The IP or MAC address of our interface changed.
+    void UpdateAddress(const DiscoveryPacketHeader &network) {
+        MutexLock l(&mutex_);
+        memcpy(header_.ip_address, network.ip_address,
+               sizeof(header_.ip_address));
+        memcpy(header_.mac_address, network.mac_address,
+               sizeof(header_.mac_address));
+    }
+
+    // The MTU of our interface changed: re-advertise as many strips per
+    // packet as fit without fragmentation.
+    void UpdateMTU(int mtu) {
+        MutexLock l(&mutex_);
+        if (mtu <= 0 || mtu == mtu_)
+            return;
+        const int udp_packet_size = UDPPacketSizeForMTU(mtu);
+        const int strips = MaxStripsPerPacket(udp_packet_size,
+                                              pixel_pusher_.base->pixels_per_strip,
+                                              pixel_pusher_.base->strips_attached);
+        mtu_ = mtu;
+        if (strips == 0) {
+            fprintf(stderr, "MTU now %d, too small to transmit one row; "
+                    "keep advertising %d strips per packet.\n",
+                    mtu, pixel_pusher_.base->max_strips_per_packet);
+            return;
+        }
+        fprintf(stderr, "MTU changed to %d. Accepting max %d strips per "
+                "packet (with UDP packet limit %d).\n",
+                mtu, strips, udp_packet_size);
+        pixel_pusher_.base->max_strips_per_packet = strips;
     }
 
     virtual void Run() {
@@ -195,9 +258,11 @@ public:
                 "broadcasting to port %d\n", kPixelPusherDiscoveryPort);
         struct timespec sleep_time = { 1, 0 };  // todo: tweak.
         while (running()) {
+            const uint32_t power_total = output_->power_total();
             // The header is of type 'DiscoveryPacket'.
             {
                 MutexLock l(&mutex_);  // protect with stable delta sequnce.
+                pixel_pusher_.base->power_total = power_total;
 
                 uint8_t *dest = discovery_packet_buffer_;
                 memcpy(dest, &header_, sizeof(header_));
@@ -219,28 +284,27 @@ public:
     }
 
 private:
-    const DiscoveryPacketHeader header_;
+    DiscoveryPacketHeader header_;
     PixelPusherContainer pixel_pusher_;
+    StripOutput *const output_;
+    int mtu_;
     const size_t pixel_pusher_base_size_;
     const size_t discovery_packet_size_;
     uint8_t *discovery_packet_buffer_;
     Mutex mutex_;
-    uint32_t previous_sequence_;
 };
 
 class PacketReceiver : public StoppableThread {
 public:
-    PacketReceiver(pp::OutputDevice *output, Beacon *beacon)
-        : output_(output), beacon_(beacon) { }
+    PacketReceiver(StripOutput *output, SenderArbiter *arbiter, Beacon *beacon)
+        : output_(output), arbiter_(arbiter), beacon_(beacon) { }
 
     virtual void Run() {
         char *packet_buffer = new char[kMaxUDPPacketSize];
         const int strip_data_len = (1 /* strip number */
-                                    + 3 * output_->num_pixel_per_strip());
-        struct StripData {
-            uint8_t strip_index;
-            ::pp::PixelColor pixel[0];
-        };
+                                    + 3 * output_->pixels_per_strip());
+        StripOutput::Strip *strips
+            = new StripOutput::Strip[kMaxUDPPacketSize / strip_data_len + 1];
 
         int s;
         if ((s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)) < 0) {
@@ -259,14 +323,15 @@ public:
         }
         fprintf(stderr, "Listening for pixels pushed to port %d\n",
                 kPixelPusherListenPort);
-        // Create an off-screen canvas to draw on, and get on-screen.
-        const int all_rows = output_->num_strips();
+        struct sockaddr_in sender;
         while (running()) {
+            socklen_t sender_len = sizeof(sender);
             ssize_t buffer_bytes = recvfrom(s, packet_buffer, kMaxUDPPacketSize,
-                                            0, NULL, 0);
+                                            0, (struct sockaddr *) &sender,
+                                            &sender_len);
             if (!running())
                 break;
-            const int64_t start_time = CurrentTimeMicros();
+            const int64_t start_time = MonotonicMicros();
             if (buffer_bytes < 0) {
                 perror("receive problem");
                 continue;
@@ -283,6 +348,13 @@ public:
             buffer_bytes -= 4;
             buf_pos += 4;
 
+            // Before we spend any time on it, see if we want this packet.
+            uint32_t missed_packets;
+            if (arbiter_->Arbitrate(sender, sequence, start_time,
+                                   &missed_packets) != SenderArbiter::ACCEPT) {
+                continue;
+            }
+
             if (buffer_bytes >= (int)sizeof(kPixelPusherCommandMagic)
                 && memcmp(buf_pos, kPixelPusherCommandMagic,
                           sizeof(kPixelPusherCommandMagic)) == 0) {
@@ -295,49 +367,407 @@ public:
             if (buffer_bytes % strip_data_len != 0) {
                 fprintf(stderr, "Expecting multiple of {1 + (rgb)*%d} = %d, "
                         "but got %zd bytes (leftover: %zd)\n",
-                        output_->num_pixel_per_strip(),
+                        output_->pixels_per_strip(),
                         strip_data_len, buffer_bytes,
                         buffer_bytes % strip_data_len);
                 continue;
             }
 
             const int received_strips = buffer_bytes / strip_data_len;
-            const bool got_full_update = (received_strips == all_rows);
-            output_->StartFrame(got_full_update);
             for (int i = 0; i < received_strips; ++i) {
-                StripData *data = (StripData *) buf_pos;
-                // Copy into frame buffer.
-                for (int x = 0; x < output_->num_pixel_per_strip(); ++x) {
-                    output_->SetPixel(data->strip_index, x, data->pixel[x]);
-                }
+                strips[i].index = (uint8_t) buf_pos[0];
+                strips[i].rgb = (const uint8_t *) buf_pos + 1;
                 buf_pos += strip_data_len;
             }
-            output_->FlushFrame();
-            const int64_t end_time = CurrentTimeMicros();
-            beacon_->UpdatePacketStats(sequence, end_time - start_time);
+            output_->SendFrame(strips, received_strips);
+            const int64_t end_time = MonotonicMicros();
+            beacon_->UpdatePacketStats(sender, missed_packets,
+                                       end_time - start_time);
         }
+        delete [] strips;
         delete [] packet_buffer;
     }
 
 private:
-    pp::OutputDevice *const output_;
+    StripOutput *const output_;
+    SenderArbiter *const arbiter_;
     Beacon *const beacon_;
 };
 
+// Receives frames from producers on the same host. Instead of sending
+// packets, they write frames into shared memory we hand out when they
+// connect to our Unix domain socket. See pp-local-producer.h for the
+// protocol.
+class LocalReceiver : public StoppableThread {
+public:
+    // The beacon is set with set_beacon() before Start(), as we are
+    // created before the network is up.
+    LocalReceiver(const char *socket_path, StripOutput *output,
+                  SenderArbiter *arbiter)
+        : socket_path_(strdup(socket_path)), output_(output),
+          arbiter_(arbiter), beacon_(NULL), listen_fd_(-1), shm_(NULL),
+          frames_received_(0) {
+        const int strip_bytes = 3 * output_->pixels_per_strip();
+        info_.magic = ::pp::kLocalFrameMagic;
+        info_.version = ::pp::kLocalFrameVersion;
+        info_.num_strips = output_->num_strips();
+        info_.pixels_per_strip = output_->pixels_per_strip();
+        info_.num_buffers = kNumBuffers;
+        info_.buffer_size = strip_bytes * output_->num_strips();
+        info_.shm_size = kNumBuffers * info_.buffer_size;
+        strips_ = new StripOutput::Strip[kNumBuffers * output_->num_strips()];
+    }
+
+    virtual ~LocalReceiver() {
+        Stop();
+        WaitStopped();
+        if (listen_fd_ >= 0) {
+            close(listen_fd_);
+            unlink(socket_path_);
+        }
+        delete [] strips_;
+        free(socket_path_);
+    }
+
+    void set_beacon(Beacon *beacon) { beacon_ = beacon; }
+
+    // Create the listen socket.
+    bool Init() {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (strlen(socket_path_) >= sizeof(addr.sun_path)) {
+            fprintf(stderr, "Local socket path too long: %s\n", socket_path_);
+            return false;
+        }
+        strcpy(addr.sun_path, socket_path_);
+        if ((listen_fd_ = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+            perror("Local producer socket");
+            return false;
+        }
+        if (bind(listen_fd_, (struct sockaddr *) &addr, sizeof(addr)) < 0
+            && (errno != EADDRINUSE || !RemoveStaleSocket(addr)
+                || bind(listen_fd_, (struct sockaddr *) &addr,
+                        sizeof(addr)) < 0)) {
+            perror("Local producer socket");
+            close(listen_fd_);
+            listen_fd_ = -1;   // Don't remove what isn't ours.
+            return false;
+        }
+        if (listen(listen_fd_, 1) < 0) {
+            perror("Local producer socket");
+            return false;
+        }
+        return true;
+    }
+
+    virtual void Run() {
+        fprintf(stderr, "Accepting local producers at %s\n", socket_path_);
+        while (running()) {
+            if (!WaitReadable(listen_fd_))
+                continue;
+            const int client = accept(listen_fd_, NULL, NULL);
+            if (client < 0) {
+                perror("accept local producer");
+                continue;
+            }
+            // Each producer gets its own shared memory, so that one that is
+            // gone can't scribble into the frames of the next.
+            const int shm_fd = CreateSharedMemory();
+            if (shm_fd >= 0) {
+                if (SendInfo(client, shm_fd)) {
+                    ServeProducer(client);
+                }
+                close(shm_fd);
+                munmap(shm_, info_.shm_size);
+                shm_ = NULL;
+            }
+            close(client);
+        }
+    }
+
+private:
+    enum { kNumBuffers = 2 };
+
+    // Wait until the file descriptor is readable, but not longer than
+    // half a second, so that we can check if we should still be running.
+    bool WaitReadable(int fd) {
+        struct pollfd p = { fd, POLLIN, 0 };
+        return poll(&p, 1, 500) > 0;
+    }
+
+    // There is something at the path of our socket. Remove it if it is a
+    // leftover from a previous run, but not if a server still listens there.
+    bool RemoveStaleSocket(const struct sockaddr_un &addr) {
+        const int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (probe < 0)
+            return false;
+        const bool stale = (connect(probe, (const struct sockaddr *) &addr,
+                                    sizeof(addr)) < 0
+                            && errno == ECONNREFUSED);
+        close(probe);
+        if (!stale) {
+            fprintf(stderr, "Local socket %s is in use by another server.\n",
+                    socket_path_);
+            errno = EADDRINUSE;
+            return false;
+        }
+        return unlink(socket_path_) == 0;
+    }
+
+    // Create and map fresh shared memory for the frame buffers and point
+    // the strips into it. Returns the file descriptor or -1 on failure.
+    int CreateSharedMemory() {
+        const int shm_fd = memfd_create("pixelpusher-frames", MFD_CLOEXEC);
+        if (shm_fd < 0 || ftruncate(shm_fd, info_.shm_size) < 0) {
+            perror("Creating shared memory for local producer");
+            if (shm_fd >= 0) close(shm_fd);
+            return -1;
+        }
+        shm_ = (uint8_t*) mmap(NULL, info_.shm_size, PROT_READ | PROT_WRITE,
+                               MAP_SHARED, shm_fd, 0);
+        if (shm_ == MAP_FAILED) {
+            shm_ = NULL;
+            perror("Mapping shared memory for local producer");
+            close(shm_fd);
+            return -1;
+        }
+        // The strips point right into the shared memory; no copying.
+        const int strip_bytes = 3 * output_->pixels_per_strip();
+        for (int b = 0; b < kNumBuffers; ++b) {
+            for (int i = 0; i < output_->num_strips(); ++i) {
+                StripOutput::Strip *strip = &strips_[b * output_->num_strips() + i];
+                strip->index = i;
+                strip->rgb = shm_ + b * info_.buffer_size + i * strip_bytes;
+            }
+        }
+        return shm_fd;
+    }
+
+    // Send LocalFrameInfo with the shared memory file descriptor attached.
+    bool SendInfo(int client, int shm_fd) {
+        struct iovec iov = { &info_, sizeof(info_) };
+        char control[CMSG_SPACE(sizeof(int))];
+        memset(control, 0, sizeof(control));
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &shm_fd, sizeof(int));
+        if (sendmsg(client, &msg, MSG_NOSIGNAL) != sizeof(info_)) {
+            perror("Sending frame info to local producer");
+            return false;
+        }
+        return true;
+    }
+
+    // We serve one producer at a time. Others connecting meanwhile are
+    // closed right away, so they see end-of-file instead of hanging.
+    void RejectProducer() {
+        const int other = accept(listen_fd_, NULL, NULL);
+        if (other >= 0) {
+            fprintf(stderr, "Rejecting local producer: another one is "
+                    "connected.\n");
+            close(other);
+        }
+    }
+
+    void ServeProducer(int client) {
+        // Local producers show up as sender on 127.0.0.1, port 0, so that
+        // they take part in the arbitration with network senders.
+        struct sockaddr_in local_sender;
+        memset(&local_sender, 0, sizeof(local_sender));
+        local_sender.sin_family = AF_INET;
+        local_sender.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        struct pollfd fds[2] = { { client, POLLIN, 0 },
+                                 { listen_fd_, POLLIN, 0 } };
+        while (running()) {
+            if (poll(fds, 2, 500) <= 0)
+                continue;
+            if (fds[1].revents & POLLIN) {
+                RejectProducer();
+            }
+            if (fds[0].revents == 0)
+                continue;
+            uint32_t buffer_index;
+            if (recv(client, &buffer_index, sizeof(buffer_index), MSG_WAITALL)
+                != sizeof(buffer_index)) {
+                return;  // Producer went away.
+            }
+            const int64_t start_time = MonotonicMicros();
+            if (buffer_index >= kNumBuffers) {
+                fprintf(stderr, "Local producer sent invalid buffer %u\n",
+                        buffer_index);
+                return;
+            }
+            // The stream keeps frames in order, so we just count.
+            uint32_t missed_packets;
+            if (arbiter_->Arbitrate(local_sender, ++frames_received_,
+                                    start_time, &missed_packets)
+                == SenderArbiter::ACCEPT) {
+                output_->SendFrame(&strips_[buffer_index * output_->num_strips()],
+                                   output_->num_strips());
+                const int64_t end_time = MonotonicMicros();
+                beacon_->UpdatePacketStats(local_sender, missed_packets,
+                                           end_time - start_time);
+            }
+            if (send(client, &buffer_index, sizeof(buffer_index), MSG_NOSIGNAL)
+                != sizeof(buffer_index)) {
+                return;
+            }
+        }
+    }
+
+    char *const socket_path_;
+    StripOutput *const output_;
+    SenderArbiter *const arbiter_;
+    Beacon *beacon_;
+    ::pp::LocalFrameInfo info_;
+    int listen_fd_;
+    uint8_t *shm_;              // Shared with the current producer.
+    StripOutput::Strip *strips_;
+    uint32_t frames_received_;
+};
+
+// Follows changes of our network interface at runtime and tells the
+// beacon about them.
+class NetworkMonitor : public StoppableThread {
+public:
+    // The "interface" name is not copied; it has to outlive us.
+    NetworkMonitor(const char *interface, const DiscoveryPacketHeader &header,
+                   bool follow_mtu, NetlinkWatcher *netlink, Beacon *beacon)
+        : interface_(interface), header_(header), follow_mtu_(follow_mtu),
+          netlink_(netlink), beacon_(beacon) {}
+
+    virtual ~NetworkMonitor() {
+        Stop();
+        WaitStopped();
+    }
+
+    virtual void Run() {
+        while (running()) {
+            if (!netlink_->WaitForEvent(1000))
+                continue;
+            DiscoveryPacketHeader now = header_;
+            if (DetermineNetwork(interface_, &now, false)
+                && (memcmp(now.ip_address, header_.ip_address,
+                           sizeof(now.ip_address)) != 0
+                    || memcmp(now.mac_address, header_.mac_address,
+                              sizeof(now.mac_address)) != 0)) {
+                DetermineNetwork(interface_, &now, true);  // Tell the user.
+                header_ = now;
+                beacon_->UpdateAddress(header_);
+            }
+            if (follow_mtu_) {
+                beacon_->UpdateMTU(DetermineMTU(interface_));
+            }
+        }
+    }
+
+private:
+    const char *const interface_;
+    DiscoveryPacketHeader header_;
+    const bool follow_mtu_;
+    NetlinkWatcher *const netlink_;
+    Beacon *const beacon_;
+};
+
+// For devices with a refresh rate: sends frames to the device at that rate.
+class FrameRefresher : public StoppableThread {
+public:
+    FrameRefresher(StripOutput *output) : output_(output) {}
+
+    virtual ~FrameRefresher() {
+        Stop();
+        WaitStopped();
+    }
+
+    virtual void Run() {
+        const long period_nanos = 1000000000L / output_->refresh_rate_hz();
+        struct timespec next;
+        clock_gettime(CLOCK_MONOTONIC, &next);
+        while (running()) {
+            output_->RefreshFrame();
+            next.tv_nsec += period_nanos;
+            while (next.tv_nsec >= 1000000000L) {
+                next.tv_nsec -= 1000000000L;
+                next.tv_sec++;
+            }
+            // If we fell behind, don't try to catch up with a burst.
+            struct timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            if (now.tv_sec > next.tv_sec
+                || (now.tv_sec == next.tv_sec && now.tv_nsec > next.tv_nsec)) {
+                next = now;
+            }
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        }
+    }
+
+private:
+    StripOutput *const output_;
+};
+
 // Internal server implemantation.
 class PixelPusherServer {
 public:
-    PixelPusherServer() : discovery_beacon_(NULL), receiver_(NULL) {}
+    PixelPusherServer()
+        : device_(NULL), stopping_(false), starter_(NULL),
+          output_(NULL), arbiter_(NULL), discovery_beacon_(NULL),
+          receiver_(NULL), e131_receiver_(NULL), local_receiver_(NULL),
+          network_monitor_(NULL), refresher_(NULL) {}
 
     // Separate Init() from constructor as things can fail.
     bool Init(const ::pp::PPOptions &options, ::pp::OutputDevice *device);
     ~PixelPusherServer();
 
+    // Wait for the network to come up, then start all our threads.
+    // Called from Init() or, with async_start, from a separate thread.
+    bool StartServices();
+
 private:
+    bool stopping() { MutexLock l(&stop_mutex_); return stopping_; }
+
+    // Wait for the network interface to have an address. We might be
+    // started in some init script and the network is not there yet.
+    bool WaitForNetwork();
+
+    ::pp::PPOptions options_;
+    char interface_[IFNAMSIZ];   // Our copy of options.network_interface
+    ::pp::OutputDevice *device_;
+    NetlinkWatcher netlink_;
+    Mutex stop_mutex_;
+    bool stopping_;
+    Thread *starter_;
+
     DiscoveryPacketHeader header_;
     PixelPusherContainer pixel_pusher_container_;
+    StripOutput *output_;
+    SenderArbiter *arbiter_;
     Beacon *discovery_beacon_;
     PacketReceiver *receiver_;
+    E131Receiver *e131_receiver_;
+    LocalReceiver *local_receiver_;
+    NetworkMonitor *network_monitor_;
+    FrameRefresher *refresher_;
+};
+
+// Runs PixelPusherServer::StartServices() in the background.
+class AsyncStarter : public Thread {
+public:
+    AsyncStarter(PixelPusherServer *server) : server_(server) {}
+    virtual ~AsyncStarter() { WaitStopped(); }
+    virtual void Run() { server_->StartServices(); }
+
+private:
+    PixelPusherServer *const server_;
 };
 
 // Run the PixexlPusher server with the given options, sending pixels
@@ -350,22 +780,104 @@ bool PixelPusherServer::Init(const ::pp::PPOptions &options,
                 kMaxUDPPacketSize);
         return false;
     }
+    if (strlen(options.network_interface) >= IFNAMSIZ) {
+        fprintf(stderr, "Network interface name too long: %s\n",
+                options.network_interface);
+        return false;
+    }
+    strcpy(interface_, options.network_interface);
+    options_ = options;
+    // The strings of the caller are only used in here; we don't hold on
+    // to them.
+    options_.network_interface = interface_;
+    options_.priority_sender = NULL;
+    options_.local_socket_path = NULL;
+    device_ = device;
 
-    // Init PixelPusher protocol
-    memset(&header_, 0, sizeof(header_));
+    // Check and set up everything that doesn't need the network right away,
+    // so that problems are reported even with async_start.
+    const int pixels_per_strip = device->num_pixel_per_strip();
+    if (options.udp_packet_size_from_mtu) {
+        // If the interface isn't there yet, we only know once it is.
+        const int mtu = DetermineMTU(interface_);
+        if (mtu > 0 && !PacketFitsStrip(UDPPacketSizeForMTU(mtu),
+                                        pixels_per_strip)) {
+            return false;
+        }
+    } else if (!PacketFitsStrip(options.udp_packet_size, pixels_per_strip)) {
+        return false;
+    }
+    if (options.e131_universe > 0) {
+        const int last_universe = (options.e131_universe - 1
+                                   + E131Receiver::NumUniverses(
+                                       device->num_strips(), pixels_per_strip));
+        if (last_universe > 63999) {
+            fprintf(stderr, "E1.31 universes %d..%d out of range (1..63999)\n",
+                    options.e131_universe, last_universe);
+            return false;
+        }
+    }
+    output_ = new StripOutput(options, device);
+    arbiter_ = new SenderArbiter(options.sender_timeout_ms,
+                                 options.priority_sender);
+    if (options.local_socket_path != NULL) {
+        local_receiver_ = new LocalReceiver(options.local_socket_path, output_,
+                                            arbiter_);
+        if (!local_receiver_->Init())
+            return false;
+    }
 
-    // We might be started in some init script and the network is
-    // not there yet. Try up to one minute.
-    int network_retries_left = 60;
+    // Subscribe to network changes before we look at the interface the
+    // first time, so that we don't miss anything in between.
+    netlink_.Open();
 
-    while (network_retries_left &&
-           !DetermineNetwork(options.network_interface, &header_)) {
-        --network_retries_left;
-        sleep(1);
+    if (options.async_start) {
+        starter_ = new AsyncStarter(this);
+        starter_->Start();
+        return true;
     }
-    if (!network_retries_left) {
-        fprintf(stderr, "Couldn't listen on network interface %s. ",
-                options.network_interface);
+    return StartServices();
+}
+
+bool PixelPusherServer::WaitForNetwork() {
+    // Nobody is blocked by an async start, so that waits until the network
+    // is there or we are shut down. Otherwise, give up after a minute.
+    static const int64_t kMaxWaitMicros = 60 * 1000000LL;
+    const bool forever = options_.async_start;
+    const int64_t deadline = MonotonicMicros() + kMaxWaitMicros;
+    bool verbose = true;  // Only tell about problems the first time.
+    while (!DetermineNetwork(interface_, &header_, verbose)) {
+        if (verbose) {
+            fprintf(stderr, "Waiting for network interface %s\n",
+                    interface_);
+        }
+        verbose = false;
+        const int64_t remaining = (forever ? kMaxWaitMicros
+                                   : deadline - MonotonicMicros());
+        if (remaining <= 0 || stopping())
+            return false;
+        // Check again on the next network event; also every now and then,
+        // and to see if we are asked to stop.
+        netlink_.WaitForEvent(std::min(remaining / 1000, (int64_t)500));
+    }
+    if (!verbose) {
+        DetermineNetwork(interface_, &header_, true);
+    }
+    return true;
+}
+
+bool PixelPusherServer::StartServices() {
+    const ::pp::PPOptions &options = options_;
+    ::pp::OutputDevice *const device = device_;
+
+    // Init PixelPusher protocol
+    memset(&header_, 0, sizeof(header_));
+
+    if (!WaitForNetwork()) {
+        if (stopping())
+            return false;   // Shut down before the network came up.
+        fprintf(stderr, "Couldn't listen on network interface %s.\n",
+                interface_);
         return false;
     }
 
@@ -385,16 +897,23 @@ bool PixelPusherServer::Init(const ::pp::PPOptions &options,
     memset(pixel_pusher_container_.base, 0, base_size);
     pixel_pusher_container_.base->strips_attached = number_of_strips;
     pixel_pusher_container_.base->pixels_per_strip = pixels_per_strip;
-    static const int kUsablePacketSize = options.udp_packet_size - 4; // 4 bytes seq#
-    // Whatever fits in one packet, but not more than one 'frame'.
+    // With jumbo frames, we can accept a lot more than the configured
+    // default without the packets being fragmented.
+    int udp_packet_size = options.udp_packet_size;
+    const int mtu = (options.udp_packet_size_from_mtu
+                     ? DetermineMTU(interface_) : -1);
+    if (mtu > 0) {
+        udp_packet_size = UDPPacketSizeForMTU(mtu);
+        fprintf(stderr, "%s: MTU %d\n", interface_, mtu);
+    } else if (options.udp_packet_size_from_mtu) {
+        fprintf(stderr, "Couldn't determine MTU of %s; using UDP packet "
+                "size %d\n", interface_, udp_packet_size);
+    }
     pixel_pusher_container_.base->max_strips_per_packet
-        = std::min(kUsablePacketSize / (1 + 3 * pixels_per_strip),
-                   number_of_strips);
-    if (pixel_pusher_container_.base->max_strips_per_packet == 0) {
-        fprintf(stderr, "Packet size limit (%d Bytes) smaller than needed to "
-                "transmit one row (%d Bytes). Change UDP packet size.\n",
-                kUsablePacketSize, (1 + 3 * pixels_per_strip));
-        return false;
+        = MaxStripsPerPacket(udp_packet_size, pixels_per_strip,
+                             number_of_strips);
+    if (!PacketFitsStrip(udp_packet_size, pixels_per_strip)) {
+        return false;   // Only possible with an MTU we didn't know in Init()
     }
     if (options.artnet_universe >= 0 && options.artnet_channel >= 0) {
         pixel_pusher_container_.base->artnet_universe = options.artnet_universe;
@@ -405,8 +924,8 @@ bool PixelPusherServer::Init(const ::pp::PPOptions &options,
             pixels_per_strip, number_of_strips,
             pixels_per_strip, number_of_strips,
             pixel_pusher_container_.base->max_strips_per_packet,
-            options.udp_packet_size);
-    pixel_pusher_container_.base->power_total = 1;         // ?
+            udp_packet_size);
+    pixel_pusher_container_.base->power_total = 0;  // updated with each frame.
     pixel_pusher_container_.base->update_period = 1000;   // initial assumption.
     pixel_pusher_container_.base->controller_ordinal = options.controller;
     pixel_pusher_container_.base->group_ordinal = options.group;
@@ -421,18 +940,55 @@ bool PixelPusherServer::Init(const ::pp::PPOptions &options,
     pixel_pusher_container_.ext.power_domain = 0;
 
     // Create our threads.
-    discovery_beacon_ = new Beacon(header_, pixel_pusher_container_);
-    receiver_ = new PacketReceiver(device, discovery_beacon_);
+    discovery_beacon_ = new Beacon(header_, pixel_pusher_container_, output_,
+                                   mtu);
+    receiver_ = new PacketReceiver(output_, arbiter_, discovery_beacon_);
+    if (options.e131_universe > 0) {
+        struct in_addr interface_address;
+        memcpy(&interface_address, header_.ip_address,
+               sizeof(interface_address));
+        e131_receiver_ = new E131Receiver(options, output_, interface_address);
+        if (!e131_receiver_->Init())
+            return false;
+    }
+    if (local_receiver_)
+        local_receiver_->set_beacon(discovery_beacon_);
 
     // Start threads, choose priority and CPU affinity.
     receiver_->Start(0, (1<<1));         // userspace priority
+    if (e131_receiver_)
+        e131_receiver_->Start(0, (1<<1));
+    if (local_receiver_)
+        local_receiver_->Start(0, (1<<1));
     discovery_beacon_->Start(5, (1<<2)); // This should accurately send updates.
+    if (output_->refresh_rate_hz() > 0) {
+        refresher_ = new FrameRefresher(output_);
+        refresher_->Start(0, (1<<3));
+        fprintf(stderr, "Refreshing output at %dHz\n",
+                output_->refresh_rate_hz());
+    }
+
+    network_monitor_ = new NetworkMonitor(interface_, header_,
+                                          options.udp_packet_size_from_mtu,
+                                          &netlink_, discovery_beacon_);
+    network_monitor_->Start();
     return true;
 }
 
 PixelPusherServer::~PixelPusherServer() {
-    receiver_->Stop();
-    discovery_beacon_->Stop();
+    {
+        MutexLock l(&stop_mutex_);
+        stopping_ = true;
+    }
+    delete starter_;           // Waits until startup is done or gave up.
+    delete network_monitor_;   // Wakes up regularly, so can be waited for.
+    delete refresher_;         // Don't touch the device after we're gone.
+    if (receiver_) receiver_->Stop();
+    // The E1.31 and local receivers don't block forever, so we can wait for
+    // them to finish and clean up their sockets.
+    delete e131_receiver_;
+    delete local_receiver_;
+    if (discovery_beacon_) discovery_beacon_->Stop();
 #if 0
     // TODO: Receiver is blocking in recvfrom(), so we can't reliably force
     // shut down while waiting on that.
@@ -440,6 +996,7 @@ PixelPusherServer::~PixelPusherServer() {
     // Don't care, just leak to the end.
     delete receiver;
     delete discovery_beacon;
+    delete output;
     free(pixel_pusher_container_.base);
 #endif
 }
@@ -453,10 +1010,20 @@ static PixelPusherServer *running_instance = NULL;
 namespace pp {
 PPOptions::PPOptions()
     : network_interface("eth0"),
-      udp_packet_size(1460),
+      udp_packet_size(1460), udp_packet_size_from_mtu(false),
       is_logarithmic(true),
       group(0), controller(0),
-      artnet_universe(-1), artnet_channel(-1) {
+      artnet_universe(-1), artnet_channel(-1),
+      sender_timeout_ms(1000), priority_sender(NULL),
+      power_budget(0), strips_per_power_domain(0),
+      e131_universe(0), rgbw_white_amount(256),
+      local_socket_path(NULL), async_start(false) {
+    power_channel_weight[0] = 256;
+    power_channel_weight[1] = 256;
+    power_channel_weight[2] = 256;
+    rgbw_white_point[0] = 255;
+    rgbw_white_point[1] = 255;
+    rgbw_white_point[2] = 255;
 }
 
 bool StartPixelPusherServer(const PPOptions &options, OutputDevice *device) {
@@ -18,10 +18,17 @@
 #include <sched.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 #include <assert.h>
 
 namespace pp {
 namespace internal {
+int64_t MonotonicMicros() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
 void *Thread::PthreadCallRun(void *tobject) {
     reinterpret_cast<Thread*>(tobject)->Run();
     return NULL;
@@ -74,6 +74,30 @@ private:
     Mutex *const mutex_;
 };
 
+// Microseconds of a monotonic clock, which doesn't jump when the wall clock
+// is set. For timeouts and intervals.
+int64_t MonotonicMicros();
+
+// Threads deriving from this should exit Run() as soon as they see !running_
+class StoppableThread : public Thread {
+public:
+    StoppableThread() : running_(true) {}
+    virtual ~StoppableThread() { Stop(); }
+
+    // Cause stopping wait until we're done.
+    void Stop() {
+        MutexLock l(&run_mutex_);
+        running_ = false;
+    }
+
+protected:
+    bool running() { MutexLock l(&run_mutex_); return running_; }
+
+private:
+    Mutex run_mutex_;
+    bool running_;
+};
+
 }  // end namespace internal
 }  // end namespace pp
 
@@ -0,0 +1,123 @@
+// -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+//  Arbitration between hosts sending pixels to the PixelPusher server
+//
+//  Copyright (C) 2026 The pixelpusher-server authors
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "sender-arbiter.h"
+
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <string.h>
+
+// Packets that are at most this many sequence numbers behind the last one
+// seen are considered reordered or duplicate and dropped.
+static const int32_t kReorderWindow = 256;
+
+// If we see that many stale packets in a row from the same sender, it most
+// likely restarted and counts from the beginning. Resync to it.
+static const int kStaleBeforeResync = 16;
+
+namespace pp {
+namespace internal {
+SenderArbiter::SenderArbiter(int takeover_timeout_ms,
+                             const char *priority_sender)
+    : takeover_timeout_micros_(takeover_timeout_ms * (int64_t)1000),
+      has_priority_sender_(false), priority_address_(0), driver_(NULL) {
+    memset(senders_, 0, sizeof(senders_));
+    if (priority_sender != NULL) {
+        struct in_addr addr;
+        if (inet_pton(AF_INET, priority_sender, &addr) == 1) {
+            has_priority_sender_ = true;
+            priority_address_ = addr.s_addr;
+        } else {
+            fprintf(stderr, "Invalid priority sender address '%s'; ignored.\n",
+                    priority_sender);
+        }
+    }
+}
+
+SenderArbiter::Sender *SenderArbiter::FindOrCreateSender(
+    const struct sockaddr_in &from) {
+    Sender *oldest = NULL;
+    for (int i = 0; i < kMaxSenders; ++i) {
+        Sender *s = &senders_[i];
+        if (s->in_use && s->address == from.sin_addr.s_addr
+            && s->port == from.sin_port) {
+            return s;
+        }
+        if (s == driver_) continue;   // Never evict the current driver.
+        if (oldest == NULL || !s->in_use
+            || (oldest->in_use
+                && s->last_seen_micros < oldest->last_seen_micros)) {
+            oldest = s;
+        }
+    }
+    memset(oldest, 0, sizeof(*oldest));
+    oldest->address = from.sin_addr.s_addr;
+    oldest->port = from.sin_port;
+    return oldest;
+}
+
+bool SenderArbiter::IsFresh(Sender *sender, uint32_t sequence,
+                            uint32_t *missed) {
+    if (!sender->in_use) {
+        sender->in_use = true;    // First time we see this one.
+        *missed = 0;
+    } else {
+        // Signed difference to deal with wrap-around.
+        const int32_t diff = sequence - sender->last_sequence;
+        if (diff > 0) {
+            sender->counts_up = true;
+            *missed = diff - 1;
+        } else if (diff == 0 && !sender->counts_up) {
+            *missed = 0;  // Sender doesn't use sequence numbers.
+        } else if (diff > -kReorderWindow
+                   && ++sender->stale_in_a_row < kStaleBeforeResync) {
+            return false;
+        } else {
+            *missed = 0;  // Sender restarted; take it from here.
+        }
+    }
+    sender->last_sequence = sequence;
+    sender->stale_in_a_row = 0;
+    return true;
+}
+
+SenderArbiter::Verdict SenderArbiter::Arbitrate(const struct sockaddr_in &from,
+                                                uint32_t sequence,
+                                                int64_t now_micros,
+                                                uint32_t *missed) {
+    MutexLock l(&mutex_);
+    Sender *sender = FindOrCreateSender(from);
+    if (!IsFresh(sender, sequence, missed))
+        return DROP_STALE;
+    sender->last_seen_micros = now_micros;
+
+    if (sender != driver_ && driver_ != NULL && takeover_timeout_micros_ > 0) {
+        const bool is_priority = (has_priority_sender_
+                                  && sender->address == priority_address_);
+        const bool driver_is_priority = (has_priority_sender_
+                                         && driver_->address == priority_address_);
+        const bool driver_timed_out = (now_micros - driver_->last_seen_micros
+                                       > takeover_timeout_micros_);
+        if (!driver_timed_out && (driver_is_priority || !is_priority))
+            return DROP_NOT_DRIVER;
+    }
+    driver_ = sender;
+    return ACCEPT;
+}
+}  // namespace internal
+}  // namespace pp
@@ -0,0 +1,86 @@
+// -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+//  Arbitration between hosts sending pixels to the PixelPusher server
+//
+//  Copyright (C) 2026 The pixelpusher-server authors
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef PP_SENDER_ARBITER_H
+#define PP_SENDER_ARBITER_H
+
+#include <stdint.h>
+#include <netinet/in.h>
+
+#include "pp-thread.h"
+
+namespace pp {
+namespace internal {
+// Keeps track of the hosts sending to us and decides which packets to apply.
+//
+// Each sender has its own sequence number window, so UDP packets that arrive
+// late or twice are dropped before we spend time decoding them. Some senders
+// don't count up at all; until a sender does, packets with the same sequence
+// number as the last one are applied. Between
+// senders, the one currently driving keeps control until it has been silent
+// for the takeover timeout; a configured priority sender can always take over.
+// Thread-safe, so that all receivers can share one arbiter.
+class SenderArbiter {
+public:
+    enum Verdict {
+        ACCEPT,            // Apply this packet.
+        DROP_STALE,        // Older than or same as what we've seen already.
+        DROP_NOT_DRIVER    // Another sender has control right now.
+    };
+
+    // If "takeover_timeout_ms" is 0, there is no arbitration between
+    // senders: every fresh packet is applied, whoever sends it.
+    // "priority_sender" is an IPv4 address in dotted notation or NULL.
+    SenderArbiter(int takeover_timeout_ms, const char *priority_sender);
+
+    // Look at a packet with the given sequence number received from "from"
+    // at time "now_micros" and decide if it should be applied.
+    // On ACCEPT, "missed" is set to the number of sequence numbers that we
+    // skipped from this sender since its last packet.
+    Verdict Arbitrate(const struct sockaddr_in &from, uint32_t sequence,
+                      int64_t now_micros, uint32_t *missed);
+
+private:
+    struct Sender {
+        bool in_use;
+        uint32_t address;      // network byte order
+        uint16_t port;         // network byte order
+        uint32_t last_sequence;
+        bool counts_up;        // Sequence number went up at least once.
+        int stale_in_a_row;
+        int64_t last_seen_micros;
+    };
+
+    // Find sender, or create new one, possibly evicting the one that has
+    // been quiet the longest.
+    Sender *FindOrCreateSender(const struct sockaddr_in &from);
+
+    bool IsFresh(Sender *sender, uint32_t sequence, uint32_t *missed);
+
+    enum { kMaxSenders = 8 };
+    Mutex mutex_;
+    const int64_t takeover_timeout_micros_;
+    bool has_priority_sender_;
+    uint32_t priority_address_;
+    Sender senders_[kMaxSenders];
+    Sender *driver_;
+};
+}  // namespace internal
+}  // namespace pp
+
+#endif  // PP_SENDER_ARBITER_H
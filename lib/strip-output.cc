@@ -0,0 +1,139 @@
+// -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+//  Path from received strips to the OutputDevice
+//
+//  Copyright (C) 2026 The pixelpusher-server authors
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "strip-output.h"
+
+namespace pp {
+namespace internal {
+StripOutput::StripOutput(const ::pp::PPOptions &options,
+                         ::pp::OutputDevice *device)
+    : device_(device), num_strips_(device->num_strips()),
+      pixels_per_strip_(device->num_pixel_per_strip()),
+      power_limiter_(options, num_strips_, pixels_per_strip_),
+      encoder_(device->wire_encoding(), pixels_per_strip_),
+      is_rgbw_(new bool[num_strips_]),
+      scratch_(new uint8_t[3 * pixels_per_strip_]),
+      rgbw_(NULL), refresh_rate_hz_(device->refresh_rate_hz()),
+      high_depth_(false), temporal_(NULL) {
+    bool any_rgbw = false;
+    for (int i = 0; i < num_strips_; ++i) {
+        is_rgbw_[i] = device->is_rgbw_strip(i);
+        any_rgbw |= is_rgbw_[i];
+    }
+    if (any_rgbw) {
+        rgbw_ = new uint8_t[4 * pixels_per_strip_];
+    }
+    for (int c = 0; c < 3; ++c) {
+        const int wp = options.rgbw_white_point[c];
+        white_extraction_.white_point[c] = (wp < 1) ? 1 : (wp > 255 ? 255 : wp);
+        white_extraction_.inverse[c] = (255 << 8) / white_extraction_.white_point[c];
+    }
+    const int amount = options.rgbw_white_amount;
+    white_extraction_.amount = (amount < 0) ? 0 : (amount > 256 ? 256 : amount);
+
+    if (refresh_rate_hz_ > 0) {
+        int bits = device->output_bit_depth();
+        bits = (bits < 8) ? 8 : (bits > 16 ? 16 : bits);
+        // Wire encodings and RGBW are 8 bit, so only plain RGB strips get
+        // more.
+        high_depth_ = (bits > 8 && encoder_.encoded_size() == 0);
+        temporal_ = new TemporalStage(num_strips_, pixels_per_strip_, bits);
+    } else {
+        refresh_rate_hz_ = 0;
+    }
+}
+
+StripOutput::~StripOutput() {
+    delete temporal_;
+    delete [] rgbw_;
+    delete [] scratch_;
+    delete [] is_rgbw_;
+}
+
+void StripOutput::SendFrame(const Strip *strips, int count) {
+    MutexLock l(&mutex_);
+
+    // First update the power estimate with everything we got, so that
+    // all strips of a power domain are scaled the same.
+    for (int i = 0; i < count; ++i) {
+        power_limiter_.UpdateStrip(strips[i].index, strips[i].rgb);
+    }
+
+    if (temporal_) {
+        const int64_t now = MonotonicMicros();
+        for (int i = 0; i < count; ++i) {
+            const int index = strips[i].index;
+            temporal_->SetStrip(index, power_limiter_.LimitStrip(
+                                    index, strips[i].rgb, scratch_), now);
+        }
+        return;  // The device sees it with the next RefreshFrame()
+    }
+
+    device_->StartFrame(count == num_strips_);
+    for (int i = 0; i < count; ++i) {
+        const int index = strips[i].index;
+        EmitStrip(index, power_limiter_.LimitStrip(index, strips[i].rgb,
+                                                   scratch_));
+    }
+    device_->FlushFrame();
+}
+
+void StripOutput::RefreshFrame() {
+    MutexLock l(&mutex_);
+    if (!temporal_)
+        return;
+    const int64_t now = MonotonicMicros();
+    device_->StartFrame(true);
+    for (int i = 0; i < num_strips_; ++i) {
+        if (high_depth_ && !is_rgbw_[i]) {
+            device_->SetStripHighDepth(i, temporal_->Render16(i, now),
+                                       pixels_per_strip_);
+        } else {
+            EmitStrip(i, temporal_->Render8(i, now));
+        }
+    }
+    device_->FlushFrame();
+}
+
+void StripOutput::EmitStrip(int index, const uint8_t *rgb) {
+    if (index >= 0 && index < num_strips_ && is_rgbw_[index]) {
+        ExtractWhite(rgb, pixels_per_strip_, white_extraction_, rgbw_);
+        device_->SetStripRGBW(index, (const ::pp::PixelColorRGBW *) rgbw_,
+                              pixels_per_strip_);
+    } else if (encoder_.encoded_size() > 0) {
+        device_->SetEncodedStrip(index, encoder_.Encode(rgb),
+                                 encoder_.encoded_size());
+    } else {
+        const ::pp::PixelColor *pixels = (const ::pp::PixelColor *) rgb;
+        for (int x = 0; x < pixels_per_strip_; ++x) {
+            device_->SetPixel(index, x, pixels[x]);
+        }
+    }
+}
+
+void StripOutput::HandlePusherCommand(const char *buf, size_t size) {
+    MutexLock l(&mutex_);
+    device_->HandlePusherCommand(buf, size);
+}
+
+uint32_t StripOutput::power_total() {
+    MutexLock l(&mutex_);
+    return power_limiter_.power_total();
+}
+}  // namespace internal
+}  // namespace pp
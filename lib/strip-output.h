@@ -0,0 +1,92 @@
+// -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+//  Path from received strips to the OutputDevice
+//
+//  Copyright (C) 2026 The pixelpusher-server authors
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef PP_STRIP_OUTPUT_H
+#define PP_STRIP_OUTPUT_H
+
+#include <stdint.h>
+
+#include "pixel-kernels.h"
+#include "pp-server.h"
+#include "power-limiter.h"
+#include "pp-thread.h"
+#include "temporal-stage.h"
+#include "wire-encoder.h"
+
+namespace pp {
+namespace internal {
+// The path from decoded strips to the OutputDevice, shared by all the
+// receivers. Makes sure that frames from different receivers don't
+// interleave in the OutputDevice, applies power limiting, and converts strips
+// into what the device asks for: RGBW or a wire encoding.
+//
+// If the device has a refresh rate, received frames only go to the
+// TemporalStage, and RefreshFrame() sends them to the device.
+class StripOutput {
+public:
+    // A strip to be sent: its index and pixels_per_strip packed RGB triplets.
+    struct Strip {
+        int index;
+        const uint8_t *rgb;
+    };
+
+    // Does not take ownership of the device.
+    StripOutput(const ::pp::PPOptions &options, ::pp::OutputDevice *device);
+    ~StripOutput();
+
+    int num_strips() const { return num_strips_; }
+    int pixels_per_strip() const { return pixels_per_strip_; }
+
+    // Send the given strips to the device as one frame. Thread-safe.
+    void SendFrame(const Strip *strips, int count);
+
+    // Refresh rate of the device; 0 if it takes frames as they arrive.
+    int refresh_rate_hz() const { return refresh_rate_hz_; }
+
+    // Send all strips, as they should look right now, to the device.
+    // Call this refresh_rate_hz() times per second. Thread-safe.
+    void RefreshFrame();
+
+    // Pass a command on to the device. Thread-safe.
+    void HandlePusherCommand(const char *buf, size_t size);
+
+    // Estimated power of the frame currently displayed.
+    uint32_t power_total();
+
+private:
+    // Convert a strip to what the device wants and send it.
+    void EmitStrip(int index, const uint8_t *rgb);
+
+    ::pp::OutputDevice *const device_;
+    const int num_strips_;
+    const int pixels_per_strip_;
+    Mutex mutex_;
+    PowerLimiter power_limiter_;
+    WireEncoder encoder_;
+    WhiteExtraction white_extraction_;
+    bool *is_rgbw_;
+    uint8_t *scratch_;
+    uint8_t *rgbw_;
+    int refresh_rate_hz_;
+    bool high_depth_;             // Use SetStripHighDepth() for RGB strips.
+    TemporalStage *temporal_;     // NULL without refresh rate.
+};
+}  // namespace internal
+}  // namespace pp
+
+#endif  // PP_STRIP_OUTPUT_H
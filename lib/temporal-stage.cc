@@ -0,0 +1,118 @@
+// -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+//  Frame interpolation and temporal dithering for high refresh outputs
+//
+//  Copyright (C) 2026 The pixelpusher-server authors
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "temporal-stage.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "pixel-kernels.h"
+
+// If a strip didn't change for longer than this, the sender probably paused
+// or restarted. Show the new version right away instead of fading to it.
+static const int64_t kMaxInterpolationMicros = 250000;
+
+namespace pp {
+namespace internal {
+TemporalStage::TemporalStage(int num_strips, int pixels_per_strip,
+                             int output_bits)
+    : num_strips_(num_strips), strip_bytes_(3 * pixels_per_strip),
+      output_bits_(output_bits),
+      current_(new uint8_t[num_strips]),
+      updated_micros_(new int64_t[num_strips]),
+      interval_micros_(new int64_t[num_strips]),
+      error_(new uint8_t[num_strips * strip_bytes_]),
+      blend_(new uint16_t[strip_bytes_]),
+      out8_(new uint8_t[strip_bytes_]),
+      out16_(new uint16_t[strip_bytes_]) {
+    for (int i = 0; i < 2; ++i) {
+        frames_[i] = new uint8_t[num_strips * strip_bytes_];
+        memset(frames_[i], 0, num_strips * strip_bytes_);
+    }
+    memset(current_, 0, num_strips);
+    memset(updated_micros_, 0, num_strips * sizeof(*updated_micros_));
+    memset(interval_micros_, 0, num_strips * sizeof(*interval_micros_));
+
+    // Start with a random error, otherwise all values with the same
+    // fraction step to the next level at the same time.
+    unsigned int seed = 42;
+    for (int i = 0; i < num_strips * strip_bytes_; ++i) {
+        error_[i] = rand_r(&seed) & 0xff;
+    }
+}
+
+TemporalStage::~TemporalStage() {
+    delete [] out16_;
+    delete [] out8_;
+    delete [] blend_;
+    delete [] error_;
+    delete [] interval_micros_;
+    delete [] updated_micros_;
+    delete [] current_;
+    delete [] frames_[1];
+    delete [] frames_[0];
+}
+
+void TemporalStage::SetStrip(int strip, const uint8_t *rgb,
+                             int64_t now_micros) {
+    if (strip < 0 || strip >= num_strips_)
+        return;
+    const int64_t interval = now_micros - updated_micros_[strip];
+    const int offset = strip * strip_bytes_;
+    if (interval < interval_micros_[strip]) {
+        // Arrived before the transition to the latest version was done.
+        // Continue from what is shown right now, so that there is no jump.
+        Blend(strip, now_micros);
+        uint8_t *latest = frames_[current_[strip]] + offset;
+        for (int i = 0; i < strip_bytes_; ++i) {
+            latest[i] = (blend_[i] + 128) >> 8;
+        }
+    }
+    current_[strip] ^= 1;   // The latest becomes the previous.
+    memcpy(frames_[current_[strip]] + offset, rgb, strip_bytes_);
+    updated_micros_[strip] = now_micros;
+    interval_micros_[strip] = (interval <= kMaxInterpolationMicros)
+        ? interval : 0;
+}
+
+void TemporalStage::Blend(int strip, int64_t now_micros) {
+    const int offset = strip * strip_bytes_;
+    const int latest = current_[strip];
+    const int64_t interval = interval_micros_[strip];
+    const int64_t elapsed = now_micros - updated_micros_[strip];
+    const uint16_t alpha = (elapsed >= interval)
+        ? 256 : (uint16_t)(256 * elapsed / interval);
+    BlendBytes(frames_[latest ^ 1] + offset, frames_[latest] + offset,
+               strip_bytes_, alpha, blend_);
+}
+
+const uint8_t *TemporalStage::Render8(int strip, int64_t now_micros) {
+    Blend(strip, now_micros);
+    DitherLevels(blend_, strip_bytes_, 8, error_ + strip * strip_bytes_,
+                 out8_);
+    return out8_;
+}
+
+const uint16_t *TemporalStage::Render16(int strip, int64_t now_micros) {
+    Blend(strip, now_micros);
+    DitherLevels(blend_, strip_bytes_, output_bits_,
+                 error_ + strip * strip_bytes_, out16_);
+    return out16_;
+}
+}  // namespace internal
+}  // namespace pp
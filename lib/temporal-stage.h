@@ -0,0 +1,76 @@
+// -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+//  Frame interpolation and temporal dithering for high refresh outputs
+//
+//  Copyright (C) 2026 The pixelpusher-server authors
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef PP_TEMPORAL_STAGE_H
+#define PP_TEMPORAL_STAGE_H
+
+#include <stdint.h>
+
+namespace pp {
+namespace internal {
+// For devices that refresh faster than frames arrive: keeps the last two
+// received versions of each strip and renders what to show at any point in
+// time in between. The transition from the previous to the latest version
+// of a strip is spread over the interval in which the latest arrived, so it
+// is complete by the time the next one is expected. This costs one frame
+// interval of latency.
+//
+// Rendered values are temporally dithered down to the output bit depth:
+// the fraction of a level that doesn't make it into the output is carried
+// over to the next refresh, so the in-between values of the interpolation
+// (and, with more than 8 output bits, of the color levels) are not lost.
+//
+// All buffers are allocated up front; rendering does not allocate.
+class TemporalStage {
+public:
+    // Strips rendered with Render16() use "output_bits" (9..16).
+    TemporalStage(int num_strips, int pixels_per_strip, int output_bits);
+    ~TemporalStage();
+
+    // A new version of a strip ("rgb": pixels_per_strip packed RGB
+    // triplets) arrived at the given time.
+    void SetStrip(int strip, const uint8_t *rgb, int64_t now_micros);
+
+    // Render the strip for the given time as 8 bit levels. The result is
+    // valid until the next call to Render8() or Render16().
+    const uint8_t *Render8(int strip, int64_t now_micros);
+
+    // Render the strip for the given time with output_bits per channel, in
+    // the range 0..(1 << output_bits) - 1.
+    const uint16_t *Render16(int strip, int64_t now_micros);
+
+private:
+    // Blend the strip for the given time into blend_.
+    void Blend(int strip, int64_t now_micros);
+
+    const int num_strips_;
+    const int strip_bytes_;
+    const int output_bits_;
+    uint8_t *frames_[2];         // per strip, the latest is in current_[i]
+    uint8_t *current_;
+    int64_t *updated_micros_;    // when the latest version arrived
+    int64_t *interval_micros_;   // time it took to arrive; 0: show at once.
+    uint8_t *error_;             // dither error of each value
+    uint16_t *blend_;
+    uint8_t *out8_;
+    uint16_t *out16_;
+};
+}  // namespace internal
+}  // namespace pp
+
+#endif  // PP_TEMPORAL_STAGE_H
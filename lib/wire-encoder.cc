@@ -0,0 +1,104 @@
+// -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+//  Encoding of strips into LED chip wire formats
+//
+//  Copyright (C) 2026 The pixelpusher-server authors
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "wire-encoder.h"
+
+#include <string.h>
+
+#include "pixel-kernels.h"
+
+static const int kWS2812ResetBytes = 90;   // 300usec at 2.4MHz
+static const int kAPA102StartFrameBytes = 4;
+
+// WS2812 SPI bit patterns for each byte value: 24 bits, most significant
+// byte first.
+static uint8_t ws2812_lut[256][3];
+
+static void InitWS2812Table() {
+    if (ws2812_lut[0][0] != 0) return;   // Already done.
+    for (int value = 0; value < 256; ++value) {
+        uint32_t bits = 0;
+        for (int b = 7; b >= 0; --b) {
+            bits = (bits << 3) | ((value & (1 << b)) ? 0x6 : 0x4);  // 110/100
+        }
+        ws2812_lut[value][0] = bits >> 16;
+        ws2812_lut[value][1] = bits >> 8;
+        ws2812_lut[value][2] = bits;
+    }
+}
+
+namespace pp {
+namespace internal {
+WireEncoder::WireEncoder(::pp::WireEncoding encoding, int pixels_per_strip)
+    : encoding_(encoding), pixels_per_strip_(pixels_per_strip),
+      encoded_size_(0), buffer_(NULL), pixel_start_(NULL), reordered_(NULL) {
+    const int n = pixels_per_strip;
+    size_t header = 0;
+    switch (encoding) {
+    case WIRE_WS2812_SPI:
+        InitWS2812Table();
+        encoded_size_ = 9 * n + kWS2812ResetBytes;
+        reordered_ = new uint8_t[3 * n];
+        break;
+    case WIRE_APA102:
+        header = kAPA102StartFrameBytes;
+        encoded_size_ = header + 4 * n + (n + 15) / 16;
+        break;
+    case WIRE_LPD8806:
+        encoded_size_ = 3 * n + (n + 31) / 32;
+        break;
+    case WIRE_NONE:
+        return;
+    }
+    buffer_ = new uint8_t[encoded_size_];
+    memset(buffer_, 0, encoded_size_);
+    pixel_start_ = buffer_ + header;
+    if (encoding == WIRE_APA102) {
+        memset(pixel_start_ + 4 * n, 0xFF, (n + 15) / 16);   // End frame.
+    }
+}
+
+WireEncoder::~WireEncoder() {
+    delete [] reordered_;
+    delete [] buffer_;
+}
+
+const uint8_t *WireEncoder::Encode(const uint8_t *rgb) {
+    switch (encoding_) {
+    case WIRE_WS2812_SPI: {
+        RGBToGRB(rgb, pixels_per_strip_, reordered_);
+        uint8_t *out = pixel_start_;
+        for (int i = 0; i < 3 * pixels_per_strip_; ++i, out += 3) {
+            memcpy(out, ws2812_lut[reordered_[i]], 3);
+        }
+        break;
+    }
+    case WIRE_APA102:
+        RGBToAPA102(rgb, pixels_per_strip_, pixel_start_);
+        break;
+    case WIRE_LPD8806:
+        RGBToGRB(rgb, pixels_per_strip_, pixel_start_);
+        SevenBitHighSet(pixel_start_, 3 * pixels_per_strip_);
+        break;
+    case WIRE_NONE:
+        break;
+    }
+    return buffer_;
+}
+}  // namespace internal
+}  // namespace pp
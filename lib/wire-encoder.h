@@ -0,0 +1,55 @@
+// -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+//  Encoding of strips into LED chip wire formats
+//
+//  Copyright (C) 2026 The pixelpusher-server authors
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef PP_WIRE_ENCODER_H
+#define PP_WIRE_ENCODER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pp-server.h"
+
+namespace pp {
+namespace internal {
+// Encodes a strip of RGB pixels into the wire format of an LED chipset.
+// All the per-pixel work is either a table lookup or a vector shuffle; all
+// framing (start, end, latch bytes) is set up once in the constructor.
+class WireEncoder {
+public:
+    WireEncoder(::pp::WireEncoding encoding, int pixels_per_strip);
+    ~WireEncoder();
+
+    // Number of bytes of an encoded strip.
+    size_t encoded_size() const { return encoded_size_; }
+
+    // Encode pixels_per_strip packed RGB triplets. Returns a buffer of
+    // encoded_size() bytes, valid until the next call.
+    const uint8_t *Encode(const uint8_t *rgb);
+
+private:
+    const ::pp::WireEncoding encoding_;
+    const int pixels_per_strip_;
+    size_t encoded_size_;
+    uint8_t *buffer_;           // Encoded strip including framing.
+    uint8_t *pixel_start_;      // Where the pixels go in buffer_.
+    uint8_t *reordered_;        // Scratch for GRB data before expansion.
+};
+}  // namespace internal
+}  // namespace pp
+
+#endif  // PP_WIRE_ENCODER_H